@@ -1,9 +1,47 @@
 #include <map>
 #include <string>
+#include <sstream>
 #include <stdexcept>
 #include "commands.h"
 #include "messages.h"
 
+/**
+ * @brief The biggest CPU number accepted in the list of CPUs.
+ */
+
+static const int maxCpuNumber = 65535;
+
+/**
+ * @brief Parses list of CPUs given as comma separated numbers and ranges, for example "0,2,4-7".
+ *
+ * @param list The list given by the user.
+ * @return Numbers of all CPUs from the list.
+ * @throws std::invalid_argument if any element is not a number or a range, a range is reversed,
+ * or a CPU number is negative or above maxCpuNumber.
+ */
+
+std::vector<int> parseCpuList(const std::string& list)
+{
+    std::vector<int> cpus;
+    std::stringstream stream(list);
+    std::string element;
+    while (std::getline(stream, element, ','))
+    {
+        std::size_t dash = element.find('-');
+        long long first = std::stoll(dash == std::string::npos ? element : element.substr(0, dash));
+        long long last = dash == std::string::npos ? first : std::stoll(element.substr(dash + 1));
+        if (first < 0 || last < first || last > maxCpuNumber)
+        {
+            throw std::invalid_argument("Wrong range of CPUs: " + element);
+        }
+        for (long long cpu = first; cpu <= last; ++cpu)
+        {
+            cpus.push_back((int) cpu);
+        }
+    }
+    return cpus;
+}
+
 /**
  * @brief Parses command line arguments and extracts parameters for the program.
  *
@@ -21,6 +59,21 @@
  *   - "-r": Proliferation threshold (double).
  *   - "-p": Number of generations (integer).
  *   - "-k": Number of pairs for crossover (integer).
+ *   - "-s": Seed of the random generator (optional integer), runs with the same seed give the same results.
+ *   - "-t": Number of worker threads (optional integer), by default one per CPU.
+ *   - "-c": CPUs the worker threads are pinned to (optional list like "0,2,4-7").
+ *   - "-n": NUMA-aware mode (optional 0 or 1), threads and population partitions are placed on NUMA nodes.
+ *   - "-a": Stop after this many generations without accuracy change (optional integer).
+ *   - "-x": Stop when the population grows above this size (optional integer).
+ *   - "-b": Stop after this many seconds (optional double).
+ *   - "-m": Maximal number of organisms, organisms above it are culled (optional integer).
+ *   - "-g": Maximal memory of the population in megabytes, organisms above it are culled (optional double).
+ *   - "-B": Binary population file written next to the text output (optional path).
+ *   - "-C": Write a binary checkpoint every this many generations (optional integer, needs "-B").
+ *   - "-mp": Per-gene rate of point mutations of children (optional double).
+ *   - "-mi": Per-gene rate of gene insertions into children (optional double).
+ *   - "-md": Per-gene rate of gene deletions from children (optional double).
+ *   - "-ms": Per-gene rate of gene swaps inside children (optional double), the four rates sum to at most 1.
  *
  * Example usage:
  * @code
@@ -63,6 +116,94 @@ Parameters user_input(int argc, char* argv[])
             } catch (const std::invalid_argument& e) {
                 printError();
             }
+        } else if (arg == "-s") {
+            try {
+                params.seed = std::stoll(argv[i + 1]);
+            } catch (const std::invalid_argument& e) {
+                printError();
+            }
+        } else if (arg == "-t") {
+            try {
+                params.threads = std::stoi(argv[i + 1]);
+            } catch (const std::invalid_argument& e) {
+                printError();
+            }
+        } else if (arg == "-c") {
+            try {
+                params.cpus = parseCpuList(argv[i + 1]);
+            } catch (const std::invalid_argument& e) {
+                printError();
+            } catch (const std::out_of_range& e) {
+                printError();
+            }
+        } else if (arg == "-n") {
+            try {
+                params.numaAware = std::stoi(argv[i + 1]) != 0;
+            } catch (const std::invalid_argument& e) {
+                printError();
+            }
+        } else if (arg == "-a") {
+            try {
+                params.plateauGenerations = std::stoi(argv[i + 1]);
+            } catch (const std::invalid_argument& e) {
+                printError();
+            }
+        } else if (arg == "-x") {
+            try {
+                params.populationLimit = std::stoll(argv[i + 1]);
+            } catch (const std::invalid_argument& e) {
+                printError();
+            }
+        } else if (arg == "-b") {
+            try {
+                params.timeBudget = std::stod(argv[i + 1]);
+            } catch (const std::invalid_argument& e) {
+                printError();
+            }
+        } else if (arg == "-m") {
+            try {
+                params.maxPopulation = std::stoll(argv[i + 1]);
+            } catch (const std::invalid_argument& e) {
+                printError();
+            }
+        } else if (arg == "-g") {
+            try {
+                params.memoryBudget = std::stod(argv[i + 1]);
+            } catch (const std::invalid_argument& e) {
+                printError();
+            }
+        } else if (arg == "-B") {
+            params.binaryFile = argv[i + 1];
+        } else if (arg == "-C") {
+            try {
+                params.checkpointInterval = std::stoi(argv[i + 1]);
+            } catch (const std::invalid_argument& e) {
+                printError();
+            }
+        } else if (arg == "-mp") {
+            try {
+                params.pointRate = std::stod(argv[i + 1]);
+            } catch (const std::invalid_argument& e) {
+                printError();
+            }
+        } else if (arg == "-mi") {
+            try {
+                params.insertionRate = std::stod(argv[i + 1]);
+            } catch (const std::invalid_argument& e) {
+                printError();
+            }
+        } else if (arg == "-md") {
+            try {
+                params.deletionRate = std::stod(argv[i + 1]);
+            } catch (const std::invalid_argument& e) {
+                printError();
+            }
+        } else if (arg == "-ms") {
+            try {
+                params.swapRate = std::stod(argv[i + 1]);
+            } catch (const std::invalid_argument& e) {
+                printError();
+            }
         } else {
             printError();
         }
@@ -70,7 +211,12 @@ Parameters user_input(int argc, char* argv[])
 
     // Check if any required parameter is missing
     if (params.inputFile.empty() || params.outputFile.empty() || params.extinctionThreshold == 0.0 ||
-        params.proliferationThreshold == 0.0 || params.generations == 0 || params.pairsToCrossover == 0) {
+        params.proliferationThreshold == 0.0 || params.generations <= 0 || params.pairsToCrossover == 0 || params.threads < 0 ||
+        params.plateauGenerations < 0 || params.populationLimit < 0 || params.timeBudget < 0.0 ||
+        params.maxPopulation < 0 || params.memoryBudget < 0.0 || params.checkpointInterval < 0 ||
+        (params.checkpointInterval > 0 && params.binaryFile.empty()) || params.pointRate < 0.0 ||
+        params.insertionRate < 0.0 || params.deletionRate < 0.0 || params.swapRate < 0.0 ||
+        params.pointRate + params.insertionRate + params.deletionRate + params.swapRate > 1.0) {
         printError();
     }
 
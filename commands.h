@@ -2,6 +2,7 @@
 #define DARWIN_V2_COMMANDS_H
 
 #include <string>
+#include <vector>
 
 /**
  * @file darwin_v2_commands.h
@@ -19,8 +20,31 @@ struct Parameters {
     double proliferationThreshold;  ///< Proliferation threshold for the simulation.
     int generations;                ///< Number of generations for the simulation.
     int pairsToCrossover;           ///< Number of pairs to perform crossover in the simulation.
+    long long seed = -1;            ///< Seed of the random generator, negative when seeded with the current time.
+    int threads = 0;                ///< Number of worker threads, 0 means one per CPU.
+    std::vector<int> cpus;          ///< CPUs the worker threads are pinned to, empty means no pinning.
+    bool numaAware = false;         ///< Whether the population is partitioned over NUMA nodes.
+    int plateauGenerations = 0;     ///< Stop after this many generations without accuracy change, 0 disables it.
+    long long populationLimit = 0;  ///< Stop when the population grows above this size, 0 disables it.
+    double timeBudget = 0.0;        ///< Stop after this many seconds, 0 disables it.
+    long long maxPopulation = 0;    ///< Maximal number of organisms kept by the fitting pass, 0 means no limit.
+    double memoryBudget = 0.0;      ///< Maximal memory of the population in megabytes, 0 means no limit.
+    std::string binaryFile;         ///< Path to the binary population file, empty means no binary output.
+    int checkpointInterval = 0;     ///< Write a binary checkpoint every this many generations, 0 disables it.
+    double pointRate = 0.0;         ///< Per-gene rate of point mutations.
+    double insertionRate = 0.0;     ///< Per-gene rate of gene insertions.
+    double deletionRate = 0.0;      ///< Per-gene rate of gene deletions.
+    double swapRate = 0.0;          ///< Per-gene rate of gene swaps.
 };
 
+/**
+ * @brief Parses list of CPUs like "0,2,4-7".
+ *
+ * @param list The list given by the user.
+ * @return Numbers of all CPUs from the list.
+ */
+std::vector<int> parseCpuList(const std::string& list);
+
 /**
  * @brief Parses command-line arguments to extract user input parameters.
  *
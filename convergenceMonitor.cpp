@@ -0,0 +1,78 @@
+/**
+ * @file convergenceMonitor.cpp
+ * @brief Implementation of the early stop criteria.
+ */
+
+#include "convergenceMonitor.h"
+#include <cmath>
+#include <limits>
+
+ConvergenceMonitor::ConvergenceMonitor(const StopCriteria& criteria)
+    : criteria(criteria), started(std::chrono::steady_clock::now()),
+      lastAccuracy(std::numeric_limits<double>::quiet_NaN()), stableGenerations(0)
+{
+}
+
+/**
+ * @brief Checks statistics of the finished generation against the stop criteria.
+ *
+ * @param stats Statistics of the population after the generation.
+ * @return Reason to stop, StopReason::None to continue.
+ *
+ * @details Extinction always stops the simulation, as an empty population can not change anymore. Accuracy is
+ * on a plateau when it changes less than the tolerance for the given number of generations in a row.
+ */
+
+StopReason ConvergenceMonitor::update(const GenerationStats& stats)
+{
+    if (stats.population == 0)
+    {
+        return StopReason::Extinction;
+    }
+    if (criteria.populationLimit > 0 && stats.population > criteria.populationLimit)
+    {
+        return StopReason::Explosion;
+    }
+
+    double accuracy = stats.accuracy();
+    if (!std::isnan(lastAccuracy) && std::fabs(accuracy - lastAccuracy) < criteria.plateauTolerance)
+    {
+        ++stableGenerations;
+    }
+    else
+    {
+        stableGenerations = 0;
+    }
+    lastAccuracy = accuracy;
+    if (criteria.plateauGenerations > 0 && stableGenerations >= criteria.plateauGenerations)
+    {
+        return StopReason::Plateau;
+    }
+
+    if (criteria.timeBudget > 0.0)
+    {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+        if (elapsed.count() > criteria.timeBudget)
+        {
+            return StopReason::TimeBudget;
+        }
+    }
+    return StopReason::None;
+}
+
+const char* describeStopReason(StopReason reason)
+{
+    switch (reason)
+    {
+        case StopReason::Plateau:
+            return "accuracy reached a plateau";
+        case StopReason::Extinction:
+            return "population went extinct";
+        case StopReason::Explosion:
+            return "population exceeded its limit";
+        case StopReason::TimeBudget:
+            return "time budget was used up";
+        default:
+            return "all generations finished";
+    }
+}
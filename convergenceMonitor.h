@@ -0,0 +1,68 @@
+#ifndef DARWIN_CONVERGENCE_MONITOR_H
+#define DARWIN_CONVERGENCE_MONITOR_H
+
+#include <chrono>
+#include <cstddef>
+#include "evolutionProcess.h"
+
+/**
+ * @file convergenceMonitor.h
+ * @brief Declares the monitor deciding when the simulation can stop before the last generation.
+ */
+
+/**
+ * @struct StopCriteria
+ * @brief Early stop criteria given by the user, zero disables a criterion.
+ */
+struct StopCriteria {
+    int plateauGenerations = 0;         ///< Stop after this many generations without accuracy change.
+    double plateauTolerance = 1e-4;     ///< Smallest change of accuracy that is not a plateau.
+    std::size_t populationLimit = 0;    ///< Stop when the population grows above this size.
+    double timeBudget = 0.0;            ///< Stop when the simulation runs longer than this many seconds.
+};
+
+/**
+ * @brief Reason of stopping the simulation.
+ */
+enum class StopReason {
+    None,
+    Plateau,
+    Extinction,
+    Explosion,
+    TimeBudget
+};
+
+/**
+ * @class ConvergenceMonitor
+ * @brief Checks statistics of every generation against the stop criteria.
+ */
+class ConvergenceMonitor {
+public:
+    /**
+     * @brief Starts the wall clock of the time budget.
+     *
+     * @param criteria Criteria given by the user.
+     */
+    explicit ConvergenceMonitor(const StopCriteria& criteria);
+
+    /**
+     * @brief Checks statistics of the finished generation.
+     *
+     * @param stats Statistics of the population after the generation.
+     * @return Reason to stop, StopReason::None to continue.
+     */
+    StopReason update(const GenerationStats& stats);
+
+private:
+    StopCriteria criteria;
+    std::chrono::steady_clock::time_point started;
+    double lastAccuracy;
+    int stableGenerations;
+};
+
+/**
+ * @brief Returns description of the stop reason printed to the user.
+ */
+const char* describeStopReason(StopReason reason);
+
+#endif // DARWIN_CONVERGENCE_MONITOR_H
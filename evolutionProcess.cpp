@@ -10,9 +10,11 @@
 #include <algorithm>
 #include <chrono>
 #include <cmath>
+#include <cstdint>
 #include <limits>
 #include <numeric>
 #include "evolutionProcess.h"
+#include "threadPool.h"
 
 /**
  * @brief Initializes a random number generator using the current high-resolution clock time as the seed.
@@ -29,267 +31,1027 @@ auto seed = std::chrono::high_resolution_clock::now().time_since_epoch().count()
 std::mt19937 gen(seed);
 
 /**
+ * @brief Reseeds the random number generator, so the whole simulation can be repeated.
  *
- * @param matrix
+ * @param newSeed The seed given by the user.
  */
 
-void removeEmptyLines(std::vector<std::vector<int>>& matrix) {
-    matrix.erase(std::remove_if(matrix.begin(), matrix.end(),
-                                [](const std::vector<int>& row) { return row.empty(); }),
-                 matrix.end());
+void seedGenerator(unsigned long long newSeed)
+{
+    gen.seed(static_cast<std::mt19937::result_type>(newSeed));
 }
 
 /**
- * @brief Chooses random pairs of organisms from the original matrix for crossover.
+ * @brief Draws the random order in which sliced halves are connected during crossover.
  *
- * Function that selects random lines from the original matrix containing all creatures from the user's file.
- * The chosen organisms are saved to a new matrix for further crossover operations.
+ * @param slicedCount Number of sliced halves.
+ * @return Shuffled indices of the sliced halves.
+ */
+
+std::vector<size_t> crossoverOrder(size_t slicedCount)
+{
+    std::vector<size_t> mixer(slicedCount);
+    std::iota(mixer.begin(), mixer.end(), 0);
+    std::shuffle(mixer.begin(), mixer.end(), gen);
+    return mixer;
+}
+
+/**
+ * @brief Insertion or deletion waiting until the organism is rebuilt.
+ */
+
+template<typename Gene>
+struct GeneEdit
+{
+    size_t position;    ///< Index of the gene in the organism before the edits.
+    bool insertion;     ///< Whether a gene is inserted before the position, otherwise the gene is removed.
+    Gene value;         ///< The inserted gene.
+};
+
+/**
+ * @brief Small random generator (SplitMix64) used by gene-level mutations.
  *
- * @param allOrganisms The original matrix containing all creatures from the user's file.
- * @param k Parameter representing the number of pairs to cross over.
- * @return The pairsVector if executed correctly; it contains the chosen creatures for crossover.
+ * It is cheap to seed, so every child gets its own generator and children can be mutated by any thread in any
+ * order with the same result.
+ */
+
+class MutationRandom
+{
+public:
+    using result_type = std::uint64_t;
+
+    explicit MutationRandom(std::uint64_t seed) : state(seed)
+    {
+        state = (*this)(); // consecutive seeds start far apart
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    result_type operator()()
+    {
+        std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+private:
+    std::uint64_t state;
+};
+
+/**
+ * @brief Applies gene-level mutations to the organism.
+ *
+ * @param organism The organism to be mutated.
+ * @param rates Per-gene rates of the mutations and the range of new genes.
+ * @param seed Seed of the mutations of this organism.
+ *
+ * @details Instead of drawing a number for every gene, the function draws the number of genes skipped until
+ * the next mutation. With the total rate p it follows the geometric distribution floor(log(u) / log(1 - p)),
+ * so only mutated genes cost any random numbers. The kind of the mutation is then drawn in proportion to its rate.
  *
- * @details The function reads the number of pairs (k) to be chosen from the original matrix. If it is not possible
- * to perform crossover as specified by the user, or if the population becomes too small, parameter k is automatically
- * resized until it is small enough. In a loop, organisms are randomly selected and checked to ensure they do not repeat,
- * and then the pairs are added to the new matrix. To avoid duplication, the selected organisms are also removed from
- * the original matrix.
+ * Point mutations and swaps are written in place, a gene is always swapped with another gene of its organism.
+ * Insertions and deletions are gathered first and the organism is rebuilt once in a single pass.
  */
 
-std::vector<std::vector<int>> selectOrganism(std::vector<std::vector<int>>& allOrganisms, int k)
+template<typename Gene>
+void mutateGenes(std::vector<Gene>& organism, const MutationRates& rates, std::uint64_t seed)
 {
-    while (k > allOrganisms.size() / 2)
+    double total = rates.total();
+    if (total <= 0.0 || organism.empty())
     {
-        k = (int) allOrganisms.size() / 3;
+        return;
     }
 
-    std::vector<std::vector<int>> pairsVector;
+    MutationRandom random(seed);
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    std::uniform_int_distribution<int> newGene(rates.minGene, rates.maxGene);
+    double logMiss = total < 1.0 ? std::log1p(-total) : 0.0;
+    auto skippedGenes = [&unit, &random, logMiss]() -> size_t
+    {
+        if (logMiss == 0.0)
+        {
+            return 0; // every gene is mutated
+        }
+        double skipped = std::log(1.0 - unit(random)) / logMiss;
+        return skipped < 1e18 ? (size_t) skipped : (size_t) 1e18;
+    };
 
-    for (int i = 0; i < k; ++i)
+    std::vector<GeneEdit<Gene>> edits;
+    size_t length = organism.size();
+    size_t position = skippedGenes();
+    while (position < length)
     {
-        std::uniform_int_distribution<> dis(0, (int) allOrganisms.size() - 1);
+        double kind = unit(random) * total;
+        if (kind < rates.point)
+        {
+            organism[position] = (Gene) newGene(random);
+        }
+        else if (kind < rates.point + rates.insertion)
+        {
+            edits.push_back({position, true, (Gene) newGene(random)});
+        }
+        else if (kind < rates.point + rates.insertion + rates.deletion)
+        {
+            edits.push_back({position, false, Gene()});
+        }
+        else if (length > 1) // a single gene has nothing to be swapped with
+        {
+            std::uniform_int_distribution<size_t> other(0, length - 2); // every gene except the mutated one
+            size_t index = other(random);
+            std::swap(organism[position], organism[index < position ? index : index + 1]);
+        }
+        position += 1 + skippedGenes();
+    }
 
-        int line1 = dis(gen);
-        int line2;
-        do
+    if (edits.empty())
+    {
+        return;
+    }
+    std::vector<Gene> rebuilt;
+    rebuilt.reserve(length + edits.size());
+    size_t from = 0;
+    for (const GeneEdit<Gene>& edit : edits)
+    {
+        rebuilt.insert(rebuilt.end(), organism.begin() + (std::ptrdiff_t) from, organism.begin() + (std::ptrdiff_t) edit.position);
+        if (edit.insertion)
         {
-            line2 = dis(gen);
+            rebuilt.push_back(edit.value);
+            from = edit.position; // the gene itself is kept
+        }
+        else
+        {
+            from = edit.position + 1;
         }
-        while (line2 == line1); //ensure that line2 is not equal to line2
+    }
+    rebuilt.insert(rebuilt.end(), organism.begin() + (std::ptrdiff_t) from, organism.end());
+    organism.swap(rebuilt);
+}
+
+/**
+ * @brief Draws the fitting factor of the generation and prints it.
+ *
+ * @param ExtinT The user defined extinction threshold, lower bound of the factor is slightly below it.
+ * @param generation Index of the current generation.
+ * @return The factor used by the fitting function in this generation.
+ */
+
+double drawFitnessFactor(double ExtinT, int generation)
+{
+    std::uniform_real_distribution<double> randomEvolution((ExtinT - 0.04), 1.0);
+    double factor = randomEvolution(gen);
+
+    std::cout << "Generation: " << generation + 1 << "\n" << "Factor: " << factor << "\n\n";
+
+    return factor;
+}
+
+/**
+ * @brief Returns how many copies of the organism are kept by the fitting function.
+ *
+ * @param rowSum Sum of genes of the organism.
+ * @param factor The factor of the generation.
+ * @param ProLifeT The user defined parameter of doubling species in population.
+ * @param ExtinT The user defined parameter of keeping if above or removing if below species in population.
+ * @return 2 if the organism is duplicated, 1 if it is kept, 0 if it is removed.
+ */
 
-        pairsVector.push_back(allOrganisms[line1]); // Add the selected pairs to the new vector
-        pairsVector.push_back(allOrganisms[line2]);
+static int organismCopies(int rowSum, double factor, double ProLifeT, double ExtinT)
+{
+    double(*fit_func)(double, double) = [](double factor, double rowSum){return factor * ((std::cos(rowSum) / 2) + 0.5);};
 
-        allOrganisms.erase(allOrganisms.begin() + std::max(line1, line2)); // Remove the selected pairs from the original matrix
-        allOrganisms.erase(allOrganisms.begin() + std::min(line1, line2));
+    double proLifeFunction = fit_func(factor, rowSum);
+    double existFunction = fit_func(factor, rowSum);
+
+    if (proLifeFunction > ProLifeT)
+    {
+        return 2;
     }
-    return pairsVector;
+    if (existFunction < ExtinT)
+    {
+        return 0;
+    }
+    return 1;
 }
 
 /**
- * @brief Slices all organisms in half and puts them into a new matrix.
+ * @brief Returns sum of genes of the organism together with the sum of squared genes used for the gene diversity.
  *
- * Function that slices each organism in half and adds the halves to a new matrix. The resulting matrix is
- * two times longer, with each organism's chromosome split in half.
+ * Both sums are computed in one pass, so genes of every organism are read once by the fitting pass.
+ * Genes are always summed as int, so narrow gene types do not overflow.
  *
- * @param organismsToMutate The matrix containing organisms to be sliced.
- * @return The resulting matrix with organisms sliced in half if executed correctly.
+ * @param row The organism.
+ * @param squares Sum of squared genes of the organism.
+ * @return Sum of genes of the organism.
+ */
+
+template<typename Row>
+static int rowSumAndSquares(const Row& row, double& squares)
+{
+    int sum = 0;
+    squares = 0.0;
+    for (auto gene : row)
+    {
+        sum += gene;
+        squares += (double) gene * gene;
+    }
+    return sum;
+}
+
+/**
+ * @brief Returns the memory taken by a row of genes: its vector header and the heap block holding the genes.
+ *
+ * The block is charged like glibc malloc allocates it: the requested bytes plus an 8-byte header rounded up
+ * to 16 bytes, at least 32 bytes. An empty row allocates nothing.
+ *
+ * @param capacity Number of genes the row has room for.
+ * @return Bytes taken by the row.
+ */
+
+template<typename Gene>
+static size_t rowBytes(size_t capacity)
+{
+    if (capacity == 0)
+    {
+        return sizeof(std::vector<Gene>);
+    }
+    size_t block = (capacity * sizeof(Gene) + 8 + 15) / 16 * 16;
+    return sizeof(std::vector<Gene>) + std::max<size_t>(block, 32);
+}
+
+/**
+ * @brief Working memory of the fitting pass for every organism of the population: its decision, sums and
+ * selection mark.
+ */
+
+/**
+ * @brief Returns the memory the given number of copies of an organism take in the new population.
+ *
+ * The last copy is moved with its buffer, the others are copied to the exact size.
+ */
+
+template<typename Gene>
+static size_t keptBytes(const std::vector<Gene>& row, unsigned char copies)
+{
+    return rowBytes<Gene>(row.capacity()) + (copies - 1) * rowBytes<Gene>(row.size());
+}
+
+/**
+ * @brief Returns the memory the given number of copies of an inline organism take, they allocate nothing.
+ */
+
+template<typename Gene, size_t MaxLength>
+static size_t keptBytes(const InlineGenome<Gene, MaxLength>&, unsigned char copies)
+{
+    return copies * sizeof(InlineGenome<Gene, MaxLength>);
+}
+
+constexpr size_t fittingBytesPerOrganism = 2 * sizeof(unsigned char) + sizeof(int) + sizeof(double);
+
+/**
+ * @brief Number of organisms kept by the first step of the fitting pass and the memory they take.
+ */
+
+struct FitTotals
+{
+    size_t organisms = 0;
+    unsigned long long bytes = 0;
+};
+
+/**
+ * @brief First step of the fitting pass, decides how many copies of every organism from [begin, end) are kept.
  *
- * @details The function starts by checking if the half-length of the chromosome is even or odd. If it is odd,
- * one is added to make the splitting process easier. Then, each organism's chromosome is divided into two halves,
- * and the halves are added to a new matrix. The resulting matrix is two times longer than the original matrix.
+ * @param organisms Rows of the organisms to fit.
+ * @param begin Index of the first organism to fit.
+ * @param end Index after the last organism to fit.
+ * @param factor The factor of the generation drawn by drawFitnessFactor.
+ * @param ProLifeT The user defined parameter of doubling species in population.
+ * @param ExtinT The user defined parameter of keeping if above or removing if below species in population.
+ * @param skipEmpty Whether empty organisms are removed without fitting.
+ * @param selected Organisms taken for crossover, which are not fitted as survivors, may be null.
+ * @param copies Number of kept copies of every organism, filled for [begin, end).
+ * @param rowSums Sum of genes of every organism, filled for [begin, end).
+ * @param rowSquares Sum of squared genes of every organism, filled for [begin, end).
+ * @return Number of kept organisms and the memory they take in the new population.
  */
 
-std::vector<std::vector<int>> pairsForMutation(const std::vector<std::vector<int>>& organismsToMutate)
+template<typename Row>
+static FitTotals decideCopies(const std::vector<Row>& organisms, size_t begin, size_t end, double factor, double ProLifeT,
+                              double ExtinT, bool skipEmpty, const unsigned char* selected, unsigned char* copies,
+                              int* rowSums, double* rowSquares)
 {
-    std::vector<std::vector<int>> pairsToMutate;
-    for (const auto &pair: organismsToMutate) //slices vector of selected organisms
+    FitTotals totals;
+    for (size_t i = begin; i < end; ++i)
     {
-        std::size_t splitChromosome = pair.size();
-        if(splitChromosome % 2 != 0)
+        const Row& row = organisms[i];
+        if ((skipEmpty && row.empty()) || (selected != nullptr && selected[i] != 0))
         {
-            splitChromosome = (splitChromosome + 1) / 2;
+            copies[i] = 0;
+            continue;
         }
-        else
+
+        rowSums[i] = rowSumAndSquares(row, rowSquares[i]);
+        copies[i] = (unsigned char) organismCopies(rowSums[i], factor, ProLifeT, ExtinT);
+        if (copies[i] > 0)
         {
-            splitChromosome = splitChromosome / 2;
+            totals.organisms += copies[i];
+            totals.bytes += keptBytes(row, copies[i]);
         }
-        std::vector<int> firstHalfOfDNA(pair.begin(), pair.begin() + (int) splitChromosome);
-        std::vector<int> secondHalfOfDNA(pair.begin() + (int) splitChromosome, pair.end());
-        pairsToMutate.push_back(firstHalfOfDNA);
-        pairsToMutate.push_back(secondHalfOfDNA);
     }
-    return pairsToMutate;
+    return totals;
 }
 
 /**
- * @brief The function randomly mixing rows from matrix to create full Organism.
+ * @brief Returns how many organisms fit into the population limit.
+ *
+ * @param limit Bounds given by the user.
+ * @param totals Organisms the fitting pass would keep without the limit and the memory they take.
+ * @param workingBytes Memory of the generation not tied to kept organisms, such as the children buffers.
+ * @param bytesPerOrganism Working memory every kept organism needs besides its row.
+ * @return The highest allowed number of organisms.
  *
- * Function that takes random rows but not repetitively. Connect two rows and then put them in nwe matrix, so
- * later functions will be possible to implement.
+ * @details The memory budget bounds the kept population together with the working memory of the generation.
+ * What is left after workingBytes is turned into a number of organisms using the mean size of the kept copies.
+ * Culled copies are a uniform sample of them, so the kept population has the same mean size.
+ */
+
+static size_t populationCapacity(const PopulationLimit& limit, const FitTotals& totals, size_t workingBytes,
+                                 size_t bytesPerOrganism)
+{
+    size_t capacity = limit.maxPopulation > 0 ? limit.maxPopulation : std::numeric_limits<size_t>::max();
+    if (limit.memoryBudget > 0 && totals.organisms > 0)
+    {
+        if (workingBytes >= limit.memoryBudget)
+        {
+            return 0;
+        }
+        double organismBytes = (double) totals.bytes / (double) totals.organisms + (double) bytesPerOrganism;
+        capacity = std::min(capacity, (size_t) ((double) (limit.memoryBudget - workingBytes) / organismBytes));
+    }
+    return capacity;
+}
+
+/**
+ * @brief Culls kept copies with selection sampling, so exactly the needed number of them stays.
  *
- * @param slicedPairs The matrix containing sliced in half pairs of chromosomes
- * @return The resulting matrix with connected rows (full organisms).
+ * Every copy is kept with probability needed / remaining, which keeps a uniformly random subset of copies
+ * in a single streaming pass, without building the oversized population first (ordered reservoir sampling).
  *
- * @details The function starts by setting up a matrix for organisms after mixing them and initializes
- * a pseudo-random number generator using the current time as a seed. It then creates a shuffled index vector
- * to randomly select pairs of rows without repetition. The function loops through the shuffled indices,
- * connecting two rows at a time and adding the resulting merged row to the output matrix.
+ * @param copies Number of kept copies of every organism, reduced in place.
+ * @param remaining Number of copies not visited yet, including the ones in copies.
+ * @param needed Number of copies still to keep.
  */
 
-std::vector<std::vector<int>> mutation(const std::vector<std::vector<int>>& slicedPairs)
+static void cullCopies(std::vector<unsigned char>& copies, size_t& remaining, size_t& needed)
 {
-    std::vector<std::vector<int>> crossOverProcess;
+    std::uniform_real_distribution<double> unit(0.0, 1.0);
+    for (auto& count : copies)
+    {
+        unsigned char kept = 0;
+        for (unsigned char copy = 0; copy < count; ++copy)
+        {
+            if ((double) remaining * unit(gen) < (double) needed)
+            {
+                ++kept;
+                --needed;
+            }
+            --remaining;
+        }
+        count = kept;
+    }
+}
 
-    std::vector<size_t> mixer(slicedPairs.size());
-    std::iota(mixer.begin(), mixer.end(), 0);
-    std::shuffle(mixer.begin(), mixer.end(), gen);
+/**
+ * @brief Second step of the fitting pass, moves kept organisms from [begin, end) into their final places.
+ *
+ * The last copy of every organism is moved, so only duplicated organisms have their genes copied.
+ * Children built as vectors are copied into inline rows when the population stores them.
+ *
+ * @param organisms Rows of the fitted organisms, kept rows are moved out of them.
+ * @param begin Index of the first organism.
+ * @param end Index after the last organism.
+ * @param copies Number of kept copies of every organism.
+ * @param rowSums Sum of genes of every organism.
+ * @param rowSquares Sum of squared genes of every organism.
+ * @param ProLifeT The user defined parameter of doubling species in population.
+ * @param out Place of the first kept organism in the new population.
+ * @return Statistics of the kept organisms, computed from the sums without reading genes again.
+ */
 
-    for (size_t i = 0; i < mixer.size(); i += 2) {
-        size_t index1 = mixer[i];
-        size_t index2 = mixer[i + 1];
+template<typename Source, typename Output>
+static GenerationStats placeCopies(std::vector<Source>& organisms, size_t begin, size_t end,
+                                   const unsigned char* copies, const int* rowSums, const double* rowSquares,
+                                   double ProLifeT, Output out)
+{
+    GenerationStats stats;
+    for (size_t i = begin; i < end; ++i)
+    {
+        if (copies[i] == 0)
+        {
+            continue;
+        }
+        for (unsigned char copy = 0; copy < copies[i]; ++copy)
+        {
+            stats.add(rowSums[i], rowSquares[i], organisms[i].size(), ProLifeT);
+        }
+        for (unsigned char copy = 1; copy < copies[i]; ++copy)
+        {
+            *out++ = organisms[i];
+        }
+        *out++ = std::move(organisms[i]);
+    }
+    return stats;
+}
 
-        std::vector<int> mixedLine;
-        mixedLine.insert(mixedLine.end(), slicedPairs[index1].begin(), slicedPairs[index1].end());
-        mixedLine.insert(mixedLine.end(), slicedPairs[index2].begin(), slicedPairs[index2].end());
+/**
+ * @brief Selects organisms for crossover by their indices, without copying or removing them.
+ *
+ * Every line is drawn from the organisms not selected yet, so no organism is selected twice. Such a line is
+ * turned into an index of the whole population by skipping the indices already selected.
+ *
+ * @param populationSize Number of organisms in the population.
+ * @param k Number of pairs to select, resized to a third of the population if the population is too small.
+ * @return Indices of the selected organisms, two per pair, in the order of selection.
+ */
 
-        crossOverProcess.push_back(mixedLine);
+std::vector<size_t> selectOrganismIndices(size_t populationSize, int k)
+{
+    while ((size_t) k > populationSize / 2)
+    {
+        k = (int) populationSize / 3;
     }
 
-    return crossOverProcess;
+    std::vector<size_t> selected;       // in the order of selection
+    std::vector<size_t> selectedSorted; // in the order of indices, used to skip them
+    selected.reserve(2 * (size_t) k);
+
+    auto populationIndex = [&selectedSorted](size_t line)
+    {
+        size_t index = line;
+        for (size_t removed : selectedSorted)
+        {
+            if (removed > index)
+            {
+                break;
+            }
+            ++index;
+        }
+        return index;
+    };
+
+    size_t remaining = populationSize;
+    for (int i = 0; i < k; ++i)
+    {
+        std::uniform_int_distribution<> dis(0, (int) remaining - 1);
+
+        int line1 = dis(gen);
+        int line2;
+        do
+        {
+            line2 = dis(gen);
+        }
+        while (line2 == line1);
+
+        size_t index1 = populationIndex((size_t) line1);
+        size_t index2 = populationIndex((size_t) line2);
+        selected.push_back(index1);
+        selected.push_back(index2);
+        selectedSorted.insert(std::upper_bound(selectedSorted.begin(), selectedSorted.end(), index1), index1);
+        selectedSorted.insert(std::upper_bound(selectedSorted.begin(), selectedSorted.end(), index2), index2);
+        remaining -= 2;
+    }
+    return selected;
 }
 
 /**
- * @brief Function connecting two matrices containing both non-mutated and mutated organisms.
- *
- * @param unMutatedOrganisms Matrix containing non-mutated Organisms
- * @param mutatedOrganisms Matrix containing mutated organisms
+ * @brief Makes a child of two selected organisms directly from the population.
  *
- * @return The resulting matrix containing all species from both params.
+ * Every selected organism is sliced in half, and a child is made of two halves connected in the drawn order.
+ * Halves are read in place from the population instead of being copied into intermediate matrices first.
  *
- * @details The function starts by setting up empty matrix for all organisms from passed matrices, then in loop
- * all the rows from unMutatedOrganisms into connectedVectorOfAllOrganism using its constructor,
- * and then appends each row from mutatedOrganisms using push_back.
+ * @param population The population.
+ * @param selected Indices of the selected organisms returned by selectOrganismIndices.
+ * @param mixer The order of halves returned by crossoverOrder, half 2 * j is the first half of selected[j]
+ * and half 2 * j + 1 its second half.
+ * @param child Index of the child, it is made of halves mixer[2 * child] and mixer[2 * child + 1].
+ * @return The child, always built as a vector, so it may be longer than rows of the population.
  */
 
-std::vector<std::vector<int>> connectVectors(const std::vector<std::vector<int>>& unMutatedOrganisms, const std::vector<std::vector<int>>& mutatedOrganisms)
+template<typename Row>
+static std::vector<typename Row::value_type> crossoverChild(const Population<Row>& population,
+                                                            const std::vector<size_t>& selected,
+                                                            const std::vector<size_t>& mixer, size_t child)
 {
-    std::vector<std::vector<int>> connectedVectorOfAllOrganism(unMutatedOrganisms);
+    auto half = [&population, &selected](size_t sliced)
+    {
+        const Row& row = population[selected[sliced / 2]];
+        size_t split = (row.size() + 1) / 2; // the first half is longer for odd lengths
+        return sliced % 2 == 0 ? std::make_pair(row.begin(), row.begin() + (std::ptrdiff_t) split)
+                               : std::make_pair(row.begin() + (std::ptrdiff_t) split, row.end());
+    };
+
+    auto first = half(mixer[2 * child]);
+    auto second = half(mixer[2 * child + 1]);
+
+    std::vector<typename Row::value_type> row;
+    row.reserve((size_t) ((first.second - first.first) + (second.second - second.first)));
+    row.insert(row.end(), first.first, first.second);
+    row.insert(row.end(), second.first, second.second);
+    return row;
+}
+
+/**
+ * @brief Children of a single segment together with the first step of their fitting pass.
+ */
 
-    removeEmptyLines(connectedVectorOfAllOrganism);
+template<typename Gene>
+struct ChildBatch
+{
+    std::vector<size_t> indices;        ///< Index of every child, see crossoverChild.
+    Matrix<Gene> rows;
+    std::vector<unsigned char> copies;
+    std::vector<int> sums;
+    std::vector<double> squares;
+    FitTotals totals;
+    size_t longest = 0;                 ///< Length of the longest child.
 
-    for (const auto& row : mutatedOrganisms)
+    /**
+     * @brief Returns the memory taken by the children and their decisions.
+     */
+    size_t bytes() const
     {
-        connectedVectorOfAllOrganism.push_back(row);
+        size_t total = indices.capacity() * sizeof(size_t) + rows.capacity() * fittingBytesPerOrganism;
+        for (const std::vector<Gene>& row : rows)
+        {
+            total += rowBytes<Gene>(row.capacity());
+        }
+        return total + (rows.capacity() - rows.size()) * sizeof(std::vector<Gene>);
     }
-    return connectedVectorOfAllOrganism;
-}
+};
 
 /**
- * @brief Function returning sum of row from matrix
- * @param row The line from matrix.
- * @return The sum of row. @code std::accumulate(row.begin(), row.end(), 0);
+ * @brief Builds, mutates and fits the children of the batch, run by a worker of the segment's node.
  *
- * @detailed Simple function returning just a sum of row using "std::accumulate".
+ * @param population The population.
+ * @param selected Indices of the selected organisms.
+ * @param mixer The order of halves.
+ * @param batch The children to build, their indices are set by the caller.
+ * @param factor The factor of the generation.
+ * @param ProLifeT The user defined parameter of doubling species in population.
+ * @param ExtinT The user defined parameter of keeping if above or removing if below species in population.
+ * @param rates Gene-level mutations applied to the children.
+ * @param mutationSeed Seed of the generation, the child with index i is mutated with mutationSeed + i.
  */
 
-int calculateRowSum(const std::vector<int>& row)
+template<typename Row, typename Gene>
+static void breedChildren(const Population<Row>& population, const std::vector<size_t>& selected,
+                          const std::vector<size_t>& mixer, ChildBatch<Gene>& batch, double factor, double ProLifeT,
+                          double ExtinT, const MutationRates& rates, std::uint64_t mutationSeed)
 {
-    return std::accumulate(row.begin(), row.end(), 0);
+    batch.rows.reserve(batch.indices.size());
+    for (size_t child : batch.indices)
+    {
+        batch.rows.push_back(crossoverChild(population, selected, mixer, child));
+        mutateGenes(batch.rows.back(), rates, mutationSeed + child);
+        batch.longest = std::max(batch.longest, batch.rows.back().size());
+    }
+
+    size_t count = batch.rows.size();
+    batch.copies.resize(count);
+    batch.sums.resize(count);
+    batch.squares.resize(count);
+    batch.totals = decideCopies(batch.rows, 0, count, factor, ProLifeT, ExtinT, false, nullptr, batch.copies.data(),
+                                batch.sums.data(), batch.squares.data());
 }
 
 /**
- * @brief Checks if organisms meets requirements given by user.
+ * @brief Generation between its two steps: organisms are selected, children are built and every copy is decided.
  *
- * Function that calculate sums of every row and put these sums into pro-life and extinction function to remove, leave
- * as it was or double the specie.
+ * Decisions refer to organisms by their index, so they stay valid when the population is converted to another
+ * row type before the second step.
+ */
+
+template<typename Gene>
+struct Offspring
+{
+    std::vector<size_t> segmentStart;           ///< Global index of the first organism of every segment.
+    std::vector<unsigned char> survivorCopies;
+    std::vector<int> survivorSums;
+    std::vector<double> survivorSquares;
+    FitTotals survivorTotals;
+    std::vector<ChildBatch<Gene>> childBatches; ///< Children bred on the node of every segment.
+
+    /**
+     * @brief Returns the length of the longest child.
+     */
+    size_t longestChild() const
+    {
+        size_t longest = 0;
+        for (const ChildBatch<Gene>& batch : childBatches)
+        {
+            longest = std::max(longest, batch.longest);
+        }
+        return longest;
+    }
+};
+
+/**
+ * @brief First step of the generation: selection, crossover, mutation and the decisions of the fitting pass.
  *
- * @param mutatedOrganisms The matrix containing all organisms connected together (both mutated and not mutated).
+ * @param population The population, it is only read.
+ * @param k Number of pairs to cross over.
  * @param ProLifeT The user defined parameter of doubling species in population.
  * @param ExtinT The user defined parameter of keeping if above or removing if below species in population.
+ * @param generation Index of the current generation.
+ * @param rates Gene-level mutations applied to the children by mutateGenes.
+ * @return Decisions of all organisms and the children.
  *
- * @return The resulting matrix containing organism after fitting process.
- *
- * @details The function starts by setting up matrix for organisms after fitting process and pseudo random number generator.
- * Then, for each row it is calculating a sum of all integers, and puts it to both pro-life and extinction functions, which is following
- * \n \a cos(random_double * sum_of_current_row) / 1.99 + 0.501
- * \n then after calculating this equation, requirements are checked for given parameters. If result is bigger than pro-life function
- * organism is duplicated, if result is bigger than extinction functions, but smaller than pro-life function, organism is just kept in matrix,
- * otherwise the organism is removed.
+ * @details Everything that uses the random generator (selection, crossover order, the fitting factor and the seed
+ * of the mutations) is drawn first on this thread. Selection only marks indices of the organisms, and children are
+ * built from halves read in place, so nothing except the children is copied. Survivors, which do not take part
+ * in crossover, are fitted in chunks of their segment by the workers of its node. At the same time every child
+ * is built, mutated and fitted by a task on the node of its first parent. Children of different nodes are mutated
+ * with their own generators, so the result does not depend on the order the tasks run in.
  */
 
-std::vector<std::vector<int>> fittedPopulation(const std::vector<std::vector<int>>& mutatedOrganisms, double ProLifeT, double ExtinT, int generation)
+template<typename Row>
+static Offspring<typename Row::value_type> breedGeneration(const Population<Row>& population, int k, double ProLifeT,
+                                                           double ExtinT, int generation, const MutationRates& rates)
 {
-    std::vector<std::vector<int>> organismsAfterEvolution;
-    removeEmptyLines(organismsAfterEvolution);
+    using Gene = typename Row::value_type;
+    const size_t minChunkSize = populationChunkSize;
+    const size_t segmentCount = population.segments.size();
 
-    double(*fit_func)(double, double) = [](double factor, double rowSum){return factor * ((std::cos(rowSum) / 2) + 0.5);};
+    Offspring<Gene> offspring;
+    offspring.segmentStart.assign(segmentCount + 1, 0);
+    for (size_t s = 0; s < segmentCount; ++s)
+    {
+        offspring.segmentStart[s + 1] = offspring.segmentStart[s] + population.segments[s].size();
+    }
+    const size_t populationSize = offspring.segmentStart.back();
 
-    std::uniform_real_distribution<double> randomEvolution((ExtinT - 0.04), 1.0);
-    double factor = randomEvolution(gen);
+    std::vector<size_t> selected = selectOrganismIndices(populationSize, k);
+    std::vector<size_t> mixer = crossoverOrder(2 * selected.size());
+    double factor = drawFitnessFactor(ExtinT, generation);
+    std::uint64_t mutationSeed = 0;
+    if (rates.total() > 0.0) // nothing is drawn without mutations
+    {
+        mutationSeed = gen();
+        mutationSeed = (mutationSeed << 32) | gen();
+    }
 
-    std::cout << "Generation: " << generation + 1 << "\n" << "Factor: " << factor << "\n\n";
+    std::vector<unsigned char> selectedMask(populationSize, 0);
+    for (size_t index : selected)
+    {
+        selectedMask[index] = 1;
+    }
 
-    for (const auto& row : mutatedOrganisms)
+    ThreadPool& pool = sharedPool();
+    offspring.survivorCopies.resize(populationSize);
+    offspring.survivorSums.resize(populationSize);
+    offspring.survivorSquares.resize(populationSize);
+    std::vector<std::vector<std::future<FitTotals>>> survivorDecisions(segmentCount);
+    for (size_t s = 0; s < segmentCount; ++s)
     {
-        int rowSum = calculateRowSum(row);
+        const std::vector<Row>& segment = population.segments[s];
+        size_t start = offspring.segmentStart[s];
+        unsigned char* copies = offspring.survivorCopies.data() + start;
+        int* sums = offspring.survivorSums.data() + start;
+        double* squares = offspring.survivorSquares.data() + start;
+        const unsigned char* mask = selectedMask.data() + start;
+        survivorDecisions[s] = submitNodeChunks(pool, (int) s, segment.size(), minChunkSize,
+            [&segment, mask, copies, sums, squares, factor, ProLifeT, ExtinT](size_t begin, size_t end)
+            {
+                return decideCopies(segment, begin, end, factor, ProLifeT, ExtinT, true, mask, copies, sums, squares);
+            });
+    }
 
-        double proLifeFunction = fit_func(factor, rowSum);
-        double existFunction = fit_func(factor, rowSum);
+    offspring.childBatches.resize(segmentCount);
+    for (size_t child = 0; child < mixer.size() / 2; ++child)
+    {
+        offspring.childBatches[population.segmentOf(selected[mixer[2 * child] / 2])].indices.push_back(child);
+    }
+    std::vector<std::future<void>> breeding;
+    for (size_t s = 0; s < segmentCount; ++s)
+    {
+        ChildBatch<Gene>& batch = offspring.childBatches[s];
+        breeding.push_back(pool.submit(
+            [&population, &selected, &mixer, &batch, &rates, factor, ProLifeT, ExtinT, mutationSeed]()
+            {
+                breedChildren(population, selected, mixer, batch, factor, ProLifeT, ExtinT, rates, mutationSeed);
+            }, (int) s));
+    }
 
-        if (proLifeFunction > ProLifeT)
+    for (auto& segment : survivorDecisions)
+    {
+        for (auto& decision : segment)
         {
-            organismsAfterEvolution.push_back(row);
-            organismsAfterEvolution.push_back(row);
+            FitTotals chunk = pool.wait(decision);
+            offspring.survivorTotals.organisms += chunk.organisms;
+            offspring.survivorTotals.bytes += chunk.bytes;
         }
-        else
+    }
+    for (auto& batch : breeding)
+    {
+        pool.wait(batch);
+    }
+    return offspring;
+}
+
+/**
+ * @brief Second step of the generation: culling to the limit and placing the kept organisms.
+ *
+ * @param population The population the offspring was bred from, kept rows are moved out of it.
+ * @param offspring The decisions and children, children are moved out of it.
+ * @param limit Bounds of the population given by the user.
+ * @param stats Statistics of the population after the generation, gathered by the fitting pass.
+ * @return The population after the generation.
+ *
+ * @details If the kept copies do not fit into the limit, they are culled by cullCopies. Then every new segment is
+ * allocated with its exact size on its node and the kept organisms are moved into place: survivors of the segment
+ * in their original order, followed by the children bred on the node. Only duplicated organisms have their genes
+ * copied, and the copies are made on the node too. So every row stays in the segment its genes live in, and the
+ * segments are never rebalanced. They may drift apart in size, which only costs some parallelism of the smaller
+ * nodes.
+ */
+
+template<typename Row>
+static Population<Row> settleGeneration(Population<Row>& population, Offspring<typename Row::value_type>& offspring,
+                                        const PopulationLimit& limit, GenerationStats& stats, double ProLifeT)
+{
+    using Gene = typename Row::value_type;
+    const size_t minChunkSize = populationChunkSize;
+    const size_t segmentCount = population.segments.size();
+    ThreadPool& pool = sharedPool();
+
+    FitTotals totals = offspring.survivorTotals;
+    size_t workingBytes = 0; // children are counted whole, even the ones moved into the new population
+    for (const ChildBatch<Gene>& batch : offspring.childBatches)
+    {
+        totals.organisms += batch.totals.organisms;
+        totals.bytes += batch.totals.bytes;
+        workingBytes += batch.bytes();
+    }
+
+    // every kept organism takes its decision, sums and mark in the next generation
+    size_t capacity = populationCapacity(limit, totals, workingBytes, fittingBytesPerOrganism);
+    if (totals.organisms > capacity)
+    {
+        size_t remaining = totals.organisms;
+        size_t needed = capacity;
+        cullCopies(offspring.survivorCopies, remaining, needed);
+        for (ChildBatch<Gene>& batch : offspring.childBatches)
+        {
+            cullCopies(batch.copies, remaining, needed);
+        }
+    }
+
+    Population<Row> next;
+    next.segments.resize(segmentCount);
+    std::vector<std::vector<size_t>> chunkOffsets(segmentCount);
+    std::vector<size_t> survivorsKept(segmentCount, 0);
+    std::vector<std::future<void>> allocations;
+    for (size_t s = 0; s < segmentCount; ++s)
+    {
+        size_t chunkSize = nodeChunkSizeFor(pool, population.segments[s].size(), minChunkSize);
+        for (size_t i = 0; i < population.segments[s].size(); ++i)
         {
-            if (existFunction < ExtinT)
+            if (i % chunkSize == 0)
             {
-                continue;
+                chunkOffsets[s].push_back(survivorsKept[s]);
             }
-            else
+            survivorsKept[s] += offspring.survivorCopies[offspring.segmentStart[s] + i];
+        }
+        const std::vector<unsigned char>& childCopies = offspring.childBatches[s].copies;
+        size_t kept = std::accumulate(childCopies.begin(), childCopies.end(), survivorsKept[s]);
+
+        std::vector<Row>& segment = next.segments[s];
+        allocations.push_back(pool.submit([&segment, kept]() { segment.resize(kept); }, (int) s)); // first touched on the node
+    }
+    for (auto& allocation : allocations)
+    {
+        pool.wait(allocation);
+    }
+
+    std::vector<std::vector<std::future<GenerationStats>>> survivorPlacements(segmentCount);
+    std::vector<std::future<GenerationStats>> childPlacements;
+    for (size_t s = 0; s < segmentCount; ++s)
+    {
+        std::vector<Row>& from = population.segments[s];
+        std::vector<Row>& to = next.segments[s];
+        const std::vector<size_t>& offsets = chunkOffsets[s];
+        size_t start = offspring.segmentStart[s];
+        const unsigned char* copies = offspring.survivorCopies.data() + start;
+        const int* sums = offspring.survivorSums.data() + start;
+        const double* squares = offspring.survivorSquares.data() + start;
+        size_t chunkSize = nodeChunkSizeFor(pool, from.size(), minChunkSize);
+        survivorPlacements[s] = submitNodeChunks(pool, (int) s, from.size(), minChunkSize,
+            [&from, &to, &offsets, copies, sums, squares, chunkSize, ProLifeT](size_t begin, size_t end)
             {
-                organismsAfterEvolution.push_back(row);
-            }
+                auto out = to.begin() + (std::ptrdiff_t) offsets[begin / chunkSize];
+                return placeCopies(from, begin, end, copies, sums, squares, ProLifeT, out);
+            });
+
+        ChildBatch<Gene>& batch = offspring.childBatches[s];
+        size_t childrenStart = survivorsKept[s];
+        childPlacements.push_back(pool.submit([&batch, &to, childrenStart, ProLifeT]()
+            {
+                return placeCopies(batch.rows, 0, batch.rows.size(), batch.copies.data(), batch.sums.data(),
+                                   batch.squares.data(), ProLifeT, to.begin() + (std::ptrdiff_t) childrenStart);
+            }, (int) s));
+    }
+
+    stats = GenerationStats();
+    for (auto& segment : survivorPlacements)
+    {
+        for (auto& placement : segment)
+        {
+            stats.merge(pool.wait(placement));
+        }
+    }
+    for (auto& placement : childPlacements)
+    {
+        stats.merge(pool.wait(placement));
+    }
+    return next;
+}
+
+/**
+ * @brief Converts the population of inline rows into vector rows, segment by segment on their nodes.
+ *
+ * Every inline segment is released as soon as it is converted. Memory of the kept copies is counted again for
+ * the vector rows, so the limit of the generation stays exact.
+ *
+ * @param population The population of inline rows, left empty after the call.
+ * @param offspring Decisions of the generation, their memory is updated.
+ * @return The population stored as vector rows, in the same order.
+ */
+
+template<typename Gene, size_t MaxLength>
+static Population<std::vector<Gene>> widenPopulation(Population<InlineGenome<Gene, MaxLength>>& population,
+                                                     Offspring<Gene>& offspring)
+{
+    ThreadPool& pool = sharedPool();
+    Population<std::vector<Gene>> widened;
+    widened.segments.resize(population.segments.size());
+    offspring.survivorTotals.bytes = 0;
+    for (size_t s = 0; s < population.segments.size(); ++s)
+    {
+        const std::vector<InlineGenome<Gene, MaxLength>>& from = population.segments[s];
+        Matrix<Gene>& to = widened.segments[s];
+        const unsigned char* copies = offspring.survivorCopies.data() + offspring.segmentStart[s];
+        auto allocation = pool.submit([&to, &from]() { to.resize(from.size()); }, (int) s); // first touched on the node
+        pool.wait(allocation);
+        auto chunks = submitNodeChunks(pool, (int) s, from.size(), populationChunkSize,
+            [&from, &to, copies](size_t begin, size_t end)
+            {
+                unsigned long long bytes = 0;
+                for (size_t i = begin; i < end; ++i)
+                {
+                    to[i].assign(from[i].begin(), from[i].end());
+                    bytes += copies[i] > 0 ? keptBytes(to[i], copies[i]) : 0;
+                }
+                return bytes;
+            });
+        for (auto& chunk : chunks)
+        {
+            offspring.survivorTotals.bytes += pool.wait(chunk);
         }
+        std::vector<InlineGenome<Gene, MaxLength>>().swap(population.segments[s]);
     }
-    return organismsAfterEvolution;
+    return widened;
 }
 
 /**
- * @brief Calculates the average cosine value for each row in a matrix.
+ * @brief Runs a single generation as a pipeline of chunks: selection, crossover, mutation and fitting.
  *
- * This function takes a matrix and calculates the average cosine value for each row. 
- * This function aim to decide with what precision the output file was generated.
+ * The same seed always gives the same population for any number of threads and for every row type.
  *
- * If the input matrix is empty, the function returns quiet NaN to a avoid infinite loop for some reason.
+ * @param population The population, rows of kept organisms are moved out of it.
+ * @param k Number of pairs to cross over.
+ * @param ProLifeT The user defined parameter of doubling species in population.
+ * @param ExtinT The user defined parameter of keeping if above or removing if below species in population.
+ * @param generation Index of the current generation.
+ * @param limit Bounds of the population given by the user.
+ * @param stats Statistics of the population after the generation, gathered by the fitting pass.
+ * @param rates Gene-level mutations applied to the children by mutateGenes.
+ * @param widened Receives the population if it has to switch to vector rows.
+ * @return The population after the generation, empty if it was stored into widened.
  *
- * @param matrix A vector of all species.
- * @return The average cosine value for each row in the matrix, or quiet NaN if the matrix is empty.
+ * @details The generation runs in two steps, breedGeneration and settleGeneration. Between them the children are
+ * checked against the row type: if insertions made a child longer than an inline row can hold, the population
+ * is converted to vector rows and the generation is finished on them. Nothing is drawn again, so the result
+ * is the same as if the population had been stored as vectors from the start.
+ *
+ * With a single node there is one segment and the population keeps the order of survivors followed by children.
+ * With more nodes the children are interleaved with the segments, so the same seed gives the same population
+ * for the same number of nodes.
  */
 
-Results calculateAverageCosine(const std::vector<std::vector<int>>& matrix, double proLifeT)
+template<typename Row>
+Population<Row> pipelinedGeneration(Population<Row>& population, int k, double ProLifeT, double ExtinT,
+                                    int generation, const PopulationLimit& limit, GenerationStats& stats,
+                                    const MutationRates& rates, Population<std::vector<typename Row::value_type>>* widened)
 {
-    Results result;
-    if (matrix.empty())
-    {
-        result.accuracy = std::numeric_limits<double>::quiet_NaN();
-        result.perfectFits = 0;
-        return result;
-    }
-    double sumCosines = 0.0;
-    int counter_of_perfect_fits = 0;
-    for (const auto& row : matrix) {
-        int rowSum = calculateRowSum(row);
-        double cosineValue = (std::cos(rowSum) / 2) + 0.5;
-        sumCosines += cosineValue;
-        if (rowSum > proLifeT)
+    auto offspring = breedGeneration(population, k, ProLifeT, ExtinT, generation, rates);
+    if constexpr (maxRowLength<Row> != SIZE_MAX)
+    {
+        if (offspring.longestChild() > maxRowLength<Row>)
         {
-            counter_of_perfect_fits += 1;
+            Population<std::vector<typename Row::value_type>> vectors = widenPopulation(population, offspring);
+            *widened = settleGeneration(vectors, offspring, limit, stats, ProLifeT);
+            return Population<Row>();
         }
     }
-    result.accuracy = sumCosines / matrix.size();
-    result.perfectFits = counter_of_perfect_fits;
+    (void) widened;
+    return settleGeneration(population, offspring, limit, stats, ProLifeT);
+}
+
+/**
+ * @brief Adds an organism with fitness cos(sum) / 2 + 0.5, it is a perfect fit if its sum is above
+ * the proliferation threshold.
+ *
+ * @details Gene mean and M2 of the organism are computed from its sum and sum of squares, then the organism
+ * is merged like a part of the population with a single row.
+ */
+
+void GenerationStats::add(int rowSum, double geneSquares, std::size_t length, double proLifeT)
+{
+    GenerationStats row;
+    row.population = 1;
+    row.fitnessSum = (std::cos(rowSum) / 2) + 0.5;
+    row.perfectFits = rowSum > proLifeT ? 1 : 0;
+    if (length > 0)
+    {
+        row.geneCount = length;
+        row.geneMean = (double) rowSum / (double) length;
+        row.geneM2 = std::max(0.0, geneSquares - (double) rowSum * row.geneMean);
+    }
+    merge(row);
+}
+
+/**
+ * @brief Combines statistics of two parts of the population.
+ *
+ * @details Gene mean and M2 are combined with the parallel variance formula, so the result does not depend on
+ * how the population was split into chunks (up to rounding).
+ */
+
+void GenerationStats::merge(const GenerationStats& other)
+{
+    population += other.population;
+    fitnessSum += other.fitnessSum;
+    perfectFits += other.perfectFits;
+    if (other.geneCount > 0)
+    {
+        unsigned long long total = geneCount + other.geneCount;
+        double delta = other.geneMean - geneMean;
+        geneMean += delta * (double) other.geneCount / (double) total;
+        geneM2 += other.geneM2 + delta * delta * (double) geneCount * (double) other.geneCount / (double) total;
+        geneCount = total;
+    }
+}
+
+double GenerationStats::accuracy() const
+{
+    if (population == 0)
+    {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    return fitnessSum / (double) population;
+}
+
+double GenerationStats::geneDiversity() const
+{
+    if (geneCount == 0)
+    {
+        return 0.0;
+    }
+    return std::sqrt(geneM2 / (double) geneCount);
+}
+
+Results GenerationStats::results() const
+{
+    Results result;
+    result.accuracy = accuracy();
+    result.perfectFits = perfectFits;
     return result;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Explicit instantiations for every supported gene width.
+ */
+
+#define INSTANTIATE_GENERATION(Row) \
+    template Population<Row> pipelinedGeneration<Row>(Population<Row>&, int, double, double, int, \
+                                                      const PopulationLimit&, GenerationStats&, const MutationRates&, \
+                                                      Population<std::vector<Row::value_type>>*);
+
+#define INSTANTIATE_EVOLUTION_PROCESS(Gene) \
+    template void mutateGenes<Gene>(std::vector<Gene>&, const MutationRates&, std::uint64_t); \
+    FOR_EACH_ROW_TYPE(INSTANTIATE_GENERATION, Gene)
+
+INSTANTIATE_EVOLUTION_PROCESS(std::int8_t)
+INSTANTIATE_EVOLUTION_PROCESS(std::int16_t)
+INSTANTIATE_EVOLUTION_PROCESS(std::int32_t)
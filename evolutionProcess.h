@@ -1,8 +1,10 @@
 #ifndef MATRIX_OPERATIONS_H
 #define MATRIX_OPERATIONS_H
 
+#include <cstdint>
 #include <vector>
 #include <string>
+#include "population.h"
 
 struct Results {
     double accuracy;
@@ -10,72 +12,153 @@ struct Results {
 };
 
 /**
- * @file matrix_operations.h
- * @brief Declares functions for matrix operations in a Darwin V2 simulation.
+ * @struct PopulationLimit
+ * @brief Upper bounds of the population enforced by the fitting pass, zero disables a bound.
  */
+struct PopulationLimit {
+    std::size_t maxPopulation = 0;      ///< Maximal number of organisms.
+    std::size_t memoryBudget = 0;       ///< Maximal memory of organisms and working buffers of a generation in bytes.
+};
 
 /**
- * @brief Removes empty lines from the matrix.
+ * @struct MutationRates
+ * @brief Per-gene probabilities of gene-level mutations applied to children after crossover, zero disables one.
  *
- * This function removes empty lines (rows) from the given matrix, modifying it in place.
+ * At most one mutation happens to a gene, so the rates must not sum above 1.
+ */
+struct MutationRates {
+    double point = 0.0;                 ///< Probability that a gene is replaced by a random value.
+    double insertion = 0.0;             ///< Probability that a random gene is inserted before a gene.
+    double deletion = 0.0;              ///< Probability that a gene is removed.
+    double swap = 0.0;                  ///< Probability that a gene is swapped with a random gene of the same organism.
+    int minGene = 0;                    ///< The smallest value of new genes, fits the gene type of the population.
+    int maxGene = 0;                    ///< The biggest value of new genes, fits the gene type of the population.
+
+    double total() const { return point + insertion + deletion + swap; }
+};
+
+/**
+ * @struct GenerationStats
+ * @brief Statistics of the population gathered while fitting it.
  *
- * @param matrix The matrix from which empty lines will be removed.
+ * Statistics of separate chunks of the population are combined with merge, so they are never recomputed
+ * by another pass over all rows.
  */
+struct GenerationStats {
+    std::size_t population = 0;         ///< Number of organisms.
+    double fitnessSum = 0.0;            ///< Sum of cos(row_sum) / 2 + 0.5 over all organisms.
+    int perfectFits = 0;                ///< Number of organisms with row sum above the proliferation threshold.
+    unsigned long long geneCount = 0;   ///< Number of genes of all organisms.
+    double geneMean = 0.0;              ///< Mean value of a gene.
+    double geneM2 = 0.0;                ///< Sum of squared differences of genes from their mean.
+
+    /**
+     * @brief Adds an organism to the statistics.
+     *
+     * @param rowSum Sum of genes of the organism.
+     * @param geneSquares Sum of squared genes of the organism.
+     * @param length Number of genes of the organism.
+     * @param proLifeT The proliferation threshold.
+     */
+    void add(int rowSum, double geneSquares, std::size_t length, double proLifeT);
+
+    /**
+     * @brief Adds statistics of another part of the population.
+     *
+     * @param other Statistics of the other part.
+     */
+    void merge(const GenerationStats& other);
+
+    /**
+     * @brief Returns the mean fitness of the population, quiet NaN for an empty population.
+     */
+    double accuracy() const;
 
-void removeEmptyLines(std::vector<std::vector<int>>& matrix);
+    /**
+     * @brief Returns the standard deviation of genes, used as the gene diversity of the population.
+     */
+    double geneDiversity() const;
+
+    /**
+     * @brief Returns accuracy and perfect fits in the form used by the output file.
+     */
+    Results results() const;
+};
 
 /**
- * @brief Selects k organisms randomly from the provided set of organisms.
+ * @file matrix_operations.h
+ * @brief Declares functions for matrix operations in a Darwin V2 simulation.
+ */
+
+/**
+ * @brief Reseeds the random number generator used by all evolution processes.
  *
- * @param allOrganisms The set of all organisms.
- * @param k The number of organisms to select.
- * @return A vector of k selected organisms.
+ * @param newSeed The seed given by the user.
  */
-std::vector<std::vector<int>> selectOrganism(std::vector<std::vector<int>>& allOrganisms, int k);
+void seedGenerator(unsigned long long newSeed);
 
 /**
- * @brief Generates pairs of organisms for mutation.
+ * @brief Selects k pairs of organisms for crossover by their indices, without copying or removing them.
  *
- * @param organismsToMutate The set of organisms to be mutated.
- * @return A vector of pairs for mutation.
+ * @param populationSize The number of organisms.
+ * @param k The number of pairs to select.
+ * @return Indices of the selected organisms, two per pair.
  */
-std::vector<std::vector<int>> pairsForMutation(const std::vector<std::vector<int>>& organismsToMutate);
+std::vector<size_t> selectOrganismIndices(size_t populationSize, int k);
 
 /**
- * @brief Applies mutation to the given pairs of organisms.
+ * @brief Draws the random order in which sliced halves are connected.
  *
- * @param slicedPairs The pairs of organisms to be mutated.
- * @return A vector of mutated organisms.
+ * @param slicedCount Number of sliced halves.
+ * @return Shuffled indices of the halves.
  */
-std::vector<std::vector<int>> mutation(const std::vector<std::vector<int>>& slicedPairs);
+std::vector<size_t> crossoverOrder(size_t slicedCount);
 
 /**
- * @brief Connects vectors from two sets of organisms.
+ * @brief Applies point, insertion, deletion and swap mutations to genes of the organism.
+ *
+ * The distance to the next mutated gene is drawn from the geometric distribution, so the cost depends on
+ * the number of mutations, not the number of genes. Mutations are drawn from a generator of their own seeded
+ * with the given seed, so organisms can be mutated by any thread in any order.
  *
- * @param unMutatedOrganisms The set of non mutated organisms.
- * @param mutatedOrganisms The set of mutated organisms.
- * @return A vector containing connected organisms.
+ * @param organism The organism to be mutated, usually a child made by crossover.
+ * @param rates Per-gene rates of the mutations and the range of new genes.
+ * @param seed Seed of the mutations of this organism.
  */
-std::vector<std::vector<int>> connectVectors(const std::vector<std::vector<int>>& unMutatedOrganisms, const std::vector<std::vector<int>>& mutatedOrganisms);
+template<typename Gene>
+void mutateGenes(std::vector<Gene>& organism, const MutationRates& rates, std::uint64_t seed);
 
 /**
- * @brief Calculates the sum of elements in a row.
+ * @brief Draws and prints the fitting factor of the generation.
  *
- * @param row The row for which the sum is to be calculated.
- * @return The sum of elements in the row.
+ * @param ExtinT The extinction threshold.
+ * @param generation Index of the current generation.
+ * @return The factor of the fitting function.
  */
-int calculateRowSum(const std::vector<int>& row);
+double drawFitnessFactor(double ExtinT, int generation);
 
 /**
- * @brief Filters the population based on proliferation and extinction thresholds.
+ * @brief Runs one generation with fitting of the survivors overlapped with crossover.
  *
- * @param mutatedOrganisms The set of mutated organisms.
+ * Every segment of the population is handled on its own NUMA node. The same seed gives the same population
+ * for any number of threads and for every row type.
+ *
+ * @param population The population, rows of kept organisms are moved out of it.
+ * @param k The number of pairs to cross over.
  * @param ProLifeT The proliferation threshold.
  * @param ExtinT The extinction threshold.
- * @return A vector of organisms that meet the specified thresholds.
+ * @param generation Index of the current generation.
+ * @param limit Bounds of the population, organisms above them are culled by the fitting pass.
+ * @param stats Statistics of the population after the generation.
+ * @param rates Gene-level mutations applied to the children, none by default.
+ * @param widened Receives the population converted to vector rows when a child outgrows the inline rows
+ * of the population, the returned population is empty then. Required for inline rows only.
+ * @return The population after the generation.
  */
-std::vector<std::vector<int>> fittedPopulation(const std::vector<std::vector<int>>& mutatedOrganisms, double ProLifeT, double ExtinT, int generation);
-
-Results calculateAverageCosine(const std::vector<std::vector<int>>& matrix, double proLifeT);
+template<typename Row>
+Population<Row> pipelinedGeneration(Population<Row>& population, int k, double ProLifeT, double ExtinT,
+                                    int generation, const PopulationLimit& limit, GenerationStats& stats,
+                                    const MutationRates& rates = MutationRates(),
+                                    Population<std::vector<typename Row::value_type>>* widened = nullptr);
 
 #endif // MATRIX_OPERATIONS_H
\ No newline at end of file
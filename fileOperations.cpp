@@ -5,71 +5,197 @@
 
 #include "fileOperations.h"
 #include "messages.h"
+#include "threadPool.h"
+#include "populationFile.h"
 #include <iostream>
 #include <fstream>
 #include <sstream>
 #include <cmath>
+#include <climits>
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <iterator>
+#include <numeric>
 #include <vector>
 
 /**
- * @brief Reads a matrix from a file and performs error checking.
+ * @brief Parses genes of a single line and passes every gene to emit.
  *
- * This function reads a matrix from the specified file and performs error checking during the process.
- * It ensures that the file is opened successfully, reads each line, validates the characters, and builds the matrix.
+ * @param line The line of the file.
+ * @param emit Callable taking every gene of the line in order.
+ * @return The first non-integer character of the line, '\0' if there is none.
+ */
+
+template<typename Emit>
+static char parseGenes(const std::string& line, Emit emit)
+{
+    std::istringstream iss(line);
+
+    char c;
+    while (iss >> c)
+    {
+        if (!std::isdigit(c) && c != '-' && c != '+')
+        {
+            // If the character is not a digit, '-', or '+', it's a non-integer character
+            return c;
+        }
+
+        iss.putback(c); // Put the character back into the stream
+        int num;
+        if (iss >> num)
+        {
+            emit(num);
+        }
+    }
+    return '\0';
+}
+
+/**
+ * @brief Part of the file scanned by a single task of the thread pool.
+ */
+
+struct ScannedChunk
+{
+    int minGene = INT_MAX;
+    int maxGene = INT_MIN;
+    std::size_t maxLength = 0;
+    int lineCount = 0;      ///< Number of lines scanned without an error.
+    int wrongLine = 0;      ///< Index of the line with a non-integer character in the chunk, 0 if there is none.
+    char wrongChar = '\0';
+};
+
+/**
+ * @brief Scans lines [begin, end) of the batch for the range of genes and the longest row, without storing them.
+ *
+ * Scanning stops at the first line with a non-integer character, which is reported by wrongLine and wrongChar.
+ *
+ * @param lines The batch of lines read from the file.
+ * @param begin Index of the first line to scan.
+ * @param end Index after the last line to scan.
+ * @return The range of genes and the longest row of the lines.
+ */
+
+static ScannedChunk scanLines(const std::vector<std::string>& lines, std::size_t begin, std::size_t end)
+{
+    ScannedChunk chunk;
+    for (std::size_t i = begin; i < end; ++i)
+    {
+        std::size_t length = 0;
+        char wrongChar = parseGenes(lines[i], [&chunk, &length](int num)
+            {
+                ++length;
+                chunk.minGene = std::min(chunk.minGene, num);
+                chunk.maxGene = std::max(chunk.maxGene, num);
+            });
+        if (wrongChar != '\0')
+        {
+            chunk.wrongLine = (int) (i - begin) + 1;
+            chunk.wrongChar = wrongChar;
+            return chunk;
+        }
+        chunk.maxLength = std::max(chunk.maxLength, length);
+        ++chunk.lineCount;
+    }
+    return chunk;
+}
+
+/**
+ * @brief Reads lines of the file in batches and passes every batch with the index of its first line to process.
+ *
+ * @param file The opened file.
+ * @param process Callable taking (lines, first line).
+ */
+
+template<typename Process>
+static void forEachBatch(std::ifstream& file, Process process)
+{
+    const std::size_t batchSize = 1 << 16;
+
+    std::vector<std::string> lines;
+    lines.reserve(batchSize);
+    std::size_t firstLine = 0;
+    bool endOfFile = false;
+    while (!endOfFile)
+    {
+        lines.clear();
+        std::string line;
+        while (lines.size() < batchSize && std::getline(file, line))
+        {
+            lines.push_back(std::move(line));
+        }
+        endOfFile = lines.size() < batchSize;
+
+        process(lines, firstLine);
+        firstLine += lines.size();
+    }
+}
+
+/**
+ * @brief Scans a matrix file and performs error checking, without keeping the matrix in memory.
+ *
+ * This function reads the specified file and performs error checking during the process.
+ * It ensures that the file is opened successfully, reads each line and validates the characters.
  * If any error is encountered, the function prints an error message and exits the program.
  *
  * @param filename The path to the file containing the matrix data.
- * @return A structure containing the read matrix, line number of error (if any), and the wrong character (if any).
+ * @return A structure describing the matrix, line number of error (if any), and the wrong character (if any).
  *
  * The function uses the following structure for the result:
- *   - `matrix`: 2D vector representing the read matrix.
- *   - `lineNumber`: Line number where an error occurred (if any).
+ *   - `lineNumber`: Line number where an error occurred (if any), otherwise the number of lines.
  *   - `wrongChar`: Wrong character found in the file (if any).
+ *   - `minGene`, `maxGene`: Range of genes found in the file.
+ *   - `geneWidth`: The narrowest gene type able to hold every gene, used to pick the population store.
+ *   - `rowCount`, `maxLength`: Number of rows and the length of the longest one, used to pick the row type.
+ *
+ * Lines are read in batches and every batch is scanned in chunks by the shared thread pool. Chunks are merged in order,
+ * so the first wrong character in the file is reported, like when reading line by line. The rows themselves are
+ * parsed by readMatrixFromFile, straight into the picked store.
  *
  * If a non-integer character is encountered in the file, an error message is printed, and the program exits.
  * If the file cannot be opened, an error message is printed, and the program exits.
  */
 
-MatrixResult readMatrixFromFile(const std::string& filename)
+MatrixResult scanMatrixFile(const std::string& filename)
 {
+    const std::size_t minChunkSize = 1024;
+
     std::ifstream file(filename);
     MatrixResult result;
     result.wrongChar = '\0'; // Initialize with null character
     result.lineNumber = 0;
+    result.minGene = INT_MAX;
+    result.maxGene = INT_MIN;
+    result.rowCount = 0;
+    result.maxLength = 0;
 
     if (file.is_open())
     {
-        std::string line;
-        while (std::getline(file, line))
+        forEachBatch(file, [&result, &filename](const std::vector<std::string>& lines, std::size_t)
         {
-            ++result.lineNumber; // Increment line number for each new line
-            std::vector<int> row;
-            std::istringstream iss(line);
+            std::vector<ScannedChunk> chunks = runInChunks(sharedPool(), lines.size(), minChunkSize,
+                [&lines](std::size_t begin, std::size_t end) { return scanLines(lines, begin, end); });
 
-            char c;
-            while (iss >> c)
+            for (auto& chunk : chunks)
             {
-                if (!std::isdigit(c) && c != '-' && c != '+')
+                if (chunk.wrongLine != 0)
                 {
-                    // If the character is not a digit, '-', or '+', it's a non-integer character
-                    result.wrongChar = c;
+                    result.lineNumber += chunk.wrongLine;
+                    result.wrongChar = chunk.wrongChar;
                     printStartMessage();
                     std::cerr << RED BOLD << "Error: Non-integer value found in file: " << filename
-                              << " (Character: " << c << " at line " << result.lineNumber << ")" << RESET << std::endl;
+                              << " (Character: " << result.wrongChar << " at line " << result.lineNumber << ")" << RESET << std::endl;
                     printInstructionForWrongFile();
                     exit(EXIT_FAILURE);
                 }
 
-                iss.putback(c); // Put the character back into the stream
-                int num;
-                if (iss >> num)
-                {
-                    row.push_back(num);
-                }
+                result.lineNumber += chunk.lineCount; // Increment line number for each new line
+                result.minGene = std::min(result.minGene, chunk.minGene);
+                result.maxGene = std::max(result.maxGene, chunk.maxGene);
+                result.maxLength = std::max(result.maxLength, chunk.maxLength);
             }
-
-            result.matrix.push_back(row);
-        }
+            result.rowCount += lines.size();
+        });
 
         file.close();
     }
@@ -80,21 +206,139 @@ MatrixResult readMatrixFromFile(const std::string& filename)
         exit(EXIT_FAILURE);
     }
 
+    if (result.minGene > result.maxGene) // no genes at all
+    {
+        result.minGene = 0;
+        result.maxGene = 0;
+    }
+    result.geneWidth = narrowestGeneWidth(result.minGene, result.maxGene);
+
     return result;
 }
 
+/**
+ * @brief Reads the matrix scanned by scanMatrixFile straight into a population of the given row type.
+ *
+ * Rows are split into equal contiguous segments, one per NUMA node of the shared thread pool. Every segment is
+ * allocated by a worker of its node, then lines are read in batches and every line is parsed by a worker of the
+ * node of its segment directly into its final row. Only the population and a single batch of lines are kept in
+ * memory, no intermediate matrix of integers is built.
+ *
+ * If the file changed since it was scanned (a row no longer fits the store), an error message is printed,
+ * and the program exits.
+ *
+ * @param filename The path to the file containing the matrix data.
+ * @param scan The result of scanMatrixFile for the file.
+ * @return The population read from the file.
+ */
+
+template<typename Row>
+Population<Row> readMatrixFromFile(const std::string& filename, const MatrixResult& scan)
+{
+    const std::size_t minChunkSize = 1024;
+
+    ThreadPool& pool = sharedPool();
+    std::size_t segmentCount = pool.nodeCount();
+    std::vector<std::size_t> segmentStart(segmentCount + 1);
+    for (std::size_t s = 0; s <= segmentCount; ++s)
+    {
+        segmentStart[s] = scan.rowCount * s / segmentCount;
+    }
+
+    Population<Row> population;
+    population.segments.resize(segmentCount);
+    for (std::size_t s = 0; s < segmentCount; ++s)
+    {
+        std::vector<Row>& segment = population.segments[s];
+        std::size_t count = segmentStart[s + 1] - segmentStart[s];
+        auto allocation = pool.submit([&segment, count]() { segment.resize(count); }, (int) s); // first touched on the node
+        pool.wait(allocation);
+    }
+
+    bool changed = false;
+    std::size_t linesRead = 0;
+    std::ifstream file(filename);
+    if (file.is_open())
+    {
+        forEachBatch(file, [&](const std::vector<std::string>& lines, std::size_t firstLine)
+        {
+            linesRead = firstLine + lines.size();
+            if (linesRead > scan.rowCount)
+            {
+                changed = true;
+                return;
+            }
+            std::vector<std::future<bool>> chunks;
+            for (std::size_t s = 0; s < segmentCount; ++s)
+            {
+                std::size_t first = std::max(firstLine, segmentStart[s]);
+                std::size_t last = std::min(firstLine + lines.size(), segmentStart[s + 1]);
+                if (first >= last)
+                {
+                    continue;
+                }
+                std::vector<Row>& segment = population.segments[s];
+                std::size_t segmentFirst = first - segmentStart[s];
+                const std::string* segmentLines = lines.data() + (first - firstLine);
+                auto segmentChunks = submitNodeChunks(pool, (int) s, last - first, minChunkSize,
+                    [&segment, &scan, segmentFirst, segmentLines](std::size_t begin, std::size_t end)
+                    {
+                        std::vector<int> genes;
+                        for (std::size_t i = begin; i < end; ++i)
+                        {
+                            genes.clear();
+                            char wrongChar = parseGenes(segmentLines[i], [&genes](int num) { genes.push_back(num); });
+                            auto range = std::minmax_element(genes.begin(), genes.end());
+                            if (wrongChar != '\0' || genes.size() > maxRowLength<Row>
+                                || (!genes.empty() && (*range.first < scan.minGene || *range.second > scan.maxGene)))
+                            {
+                                return false;
+                            }
+                            segment[segmentFirst + i].assign(genes.begin(), genes.end());
+                        }
+                        return true;
+                    });
+                std::move(segmentChunks.begin(), segmentChunks.end(), std::back_inserter(chunks));
+            }
+            for (auto& chunk : chunks)
+            {
+                changed = !pool.wait(chunk) || changed;
+            }
+        });
+
+        file.close();
+    }
+    else
+    {
+        changed = true;
+    }
+
+    if (changed || linesRead != scan.rowCount)
+    {
+        std::cerr << RED BOLD << "Error: File changed while reading: " << filename << RESET << std::endl;
+        exit(EXIT_FAILURE);
+    }
+    return population;
+}
+
 /**
  * @brief Writes a matrix of integers to a file.
  *
  * Writes the specified matrix to the specified file. Each row of the matrix is written as a line in the file,
- * and integers are separated by spaces.
+ * and integers are separated by spaces. Genes are always written as integers, also for 8-bit genes.
+ * Rows of every segment are formatted in chunks by the workers of its node and written to the file in order.
+ * The rows are processed in batches of a few chunks per thread, so only one batch of text is kept in memory
+ * at a time.
  *
- * @param matrix The matrix to write to the file.
+ * @param population The population to write to the file.
  * @param filename The name of the file to write.
  */
 
-void writeMatrixToFile(const std::vector<std::vector<int>>& matrix, const std::string& filename, double accuracy, int perfectFits)
+template<typename Row>
+void writeMatrixToFile(const Population<Row>& population, const std::string& filename, double accuracy, int perfectFits)
 {
+    const std::size_t minChunkSize = 4096;
+
     if (std::isnan(accuracy))
     {
         accuracy = 0;
@@ -106,18 +350,170 @@ void writeMatrixToFile(const std::vector<std::vector<int>>& matrix, const std::s
         file << "Accuracy: " << accuracy * 100 << "%" << std::endl;
         file << "Perfect fits: " << perfectFits << std::endl;
 
+        ThreadPool& pool = sharedPool();
+        std::size_t batchRows = minChunkSize * pool.size() * 2;
+        for (std::size_t s = 0; s < population.segments.size(); ++s)
+        {
+            const std::vector<Row>& matrix = population.segments[s];
+            for (std::size_t first = 0; first < matrix.size(); first += batchRows)
+            {
+                std::size_t count = std::min(batchRows, matrix.size() - first);
+                auto chunks = submitNodeChunks(pool, (int) s, count, minChunkSize,
+                    [&matrix, first](std::size_t begin, std::size_t end)
+                    {
+                        std::string text;
+                        char number[16];
+                        for (std::size_t i = first + begin; i < first + end; ++i)
+                        {
+                            if (!matrix[i].empty())
+                            {
+                                for (auto num : matrix[i])
+                                {
+                                    char* last = std::to_chars(number, number + sizeof(number), static_cast<int>(num)).ptr;
+                                    text.append(number, last);
+                                    text += ' ';
+                                }
+                                text += '\n';
+                            }
+                        }
+                        return text;
+                    });
+
+                for (auto& chunk : chunks)
+                {
+                    std::string text = pool.wait(chunk);
+                    file.write(text.data(), (std::streamsize) text.size());
+                }
+            }
+        }
+
+        file.close();
+    }
+}
+
+/**
+ * @brief Writes padding zeros up to the next section of the binary population file.
+ */
+
+static void padToSection(std::ofstream& file, std::uint64_t& position)
+{
+    static const char zeros[populationFileAlignment] = {};
+    std::uint64_t aligned = alignPopulationSection(position);
+    file.write(zeros, (std::streamsize) (aligned - position));
+    position = aligned;
+}
+
+/**
+ * @brief Writes the population to a binary file with the layout described in populationFile.h.
+ *
+ * Empty rows are skipped like in writeMatrixToFile. Row sums are computed in chunks by the workers of every
+ * segment's node, then the header, offsets, row sums and genes are written one after another, so the file never
+ * has to be kept in memory as a whole.
+ *
+ * @param population The population to write to the file.
+ * @param filename The name of the file to write.
+ * @param accuracy Accuracy of the population.
+ * @param perfectFits Number of perfect fits in the population.
+ * @param generation Number of generations the population went through.
+ */
+
+template<typename Row>
+void writePopulationFile(const Population<Row>& population, const std::string& filename, double accuracy, int perfectFits, int generation)
+{
+    const std::size_t minChunkSize = 4096;
+
+    std::vector<std::uint64_t> offsets(1, 0);
+    offsets.reserve(population.size() + 1);
+    for (const std::vector<Row>& matrix : population.segments)
+    {
         for (const auto& row : matrix)
         {
             if (!row.empty())
             {
-                for (int num : row)
+                offsets.push_back(offsets.back() + row.size());
+            }
+        }
+    }
+
+    ThreadPool& pool = sharedPool();
+    std::vector<std::future<std::vector<std::int64_t>>> sumChunks;
+    for (std::size_t s = 0; s < population.segments.size(); ++s)
+    {
+        const std::vector<Row>& matrix = population.segments[s];
+        auto chunks = submitNodeChunks(pool, (int) s, matrix.size(), minChunkSize,
+            [&matrix](std::size_t begin, std::size_t end)
+            {
+                std::vector<std::int64_t> sums;
+                for (std::size_t i = begin; i < end; ++i)
                 {
-                    file << num << ' ';
+                    if (!matrix[i].empty())
+                    {
+                        sums.push_back(std::accumulate(matrix[i].begin(), matrix[i].end(), (std::int64_t) 0));
+                    }
                 }
-                file << '\n';
+                return sums;
+            });
+        std::move(chunks.begin(), chunks.end(), std::back_inserter(sumChunks));
+    }
+    std::vector<std::vector<std::int64_t>> chunkSums;
+    for (auto& chunk : sumChunks)
+    {
+        chunkSums.push_back(pool.wait(chunk));
+    }
+
+    PopulationFileHeader header;
+    std::memcpy(header.magic, populationFileMagic, sizeof(header.magic));
+    header.version = populationFileVersion;
+    header.geneSize = sizeof(typename Row::value_type);
+    header.rowCount = offsets.size() - 1;
+    header.geneCount = offsets.back();
+    header.offsetsStart = alignPopulationSection(sizeof(PopulationFileHeader));
+    header.sumsStart = alignPopulationSection(header.offsetsStart + offsets.size() * sizeof(std::uint64_t));
+    header.genesStart = alignPopulationSection(header.sumsStart + header.rowCount * sizeof(std::int64_t));
+    header.accuracy = std::isnan(accuracy) ? 0.0 : accuracy;
+    header.perfectFits = perfectFits;
+    header.generation = generation;
+
+    std::ofstream file(filename, std::ios::binary);
+    if (file.is_open())
+    {
+        std::uint64_t position = 0;
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        position += sizeof(header);
+        padToSection(file, position);
+
+        file.write(reinterpret_cast<const char*>(offsets.data()), (std::streamsize) (offsets.size() * sizeof(std::uint64_t)));
+        position += offsets.size() * sizeof(std::uint64_t);
+        padToSection(file, position);
+
+        for (const auto& sums : chunkSums)
+        {
+            file.write(reinterpret_cast<const char*>(sums.data()), (std::streamsize) (sums.size() * sizeof(std::int64_t)));
+            position += sums.size() * sizeof(std::int64_t);
+        }
+        padToSection(file, position);
+
+        for (const std::vector<Row>& matrix : population.segments)
+        {
+            for (const auto& row : matrix)
+            {
+                file.write(reinterpret_cast<const char*>(row.data()), (std::streamsize) (row.size() * header.geneSize));
             }
         }
 
         file.close();
     }
-}
\ No newline at end of file
+    else
+    {
+        std::cerr << RED BOLD << "Error: Unable to open file: " << filename << RESET << std::endl;
+    }
+}
+
+#define INSTANTIATE_FILE_OPERATIONS(Row) \
+    template Population<Row> readMatrixFromFile<Row>(const std::string&, const MatrixResult&); \
+    template void writeMatrixToFile<Row>(const Population<Row>&, const std::string&, double, int); \
+    template void writePopulationFile<Row>(const Population<Row>&, const std::string&, double, int, int);
+
+FOR_EACH_ROW_TYPE(INSTANTIATE_FILE_OPERATIONS, std::int8_t)
+FOR_EACH_ROW_TYPE(INSTANTIATE_FILE_OPERATIONS, std::int16_t)
+FOR_EACH_ROW_TYPE(INSTANTIATE_FILE_OPERATIONS, std::int32_t)
@@ -3,6 +3,7 @@
 
 #include <string>
 #include <vector>
+#include "population.h"
 
 #define RESET   "\033[0m"
 #define RED     "\033[31m"
@@ -14,28 +15,58 @@
  */
 
 /**
- * @brief Reads a matrix from a file.
- *
- * @param filename The name of the file containing the matrix.
- * @return A matrix read from the file.
+ * @brief Describes a matrix file checked by scanMatrixFile.
  */
 
 struct MatrixResult
 {
     char wrongChar;
     int lineNumber;
-    std::vector<std::vector<int>> matrix;
+    int minGene;                    ///< The smallest gene found in the file.
+    int maxGene;                    ///< The biggest gene found in the file.
+    GeneWidth geneWidth;            ///< The narrowest gene type able to hold every gene from the file.
+    std::size_t rowCount;           ///< Number of rows (lines) of the file.
+    std::size_t maxLength;          ///< Number of genes of the longest row.
 };
 
-MatrixResult readMatrixFromFile(const std::string& filename);
+/**
+ * @brief Scans a matrix file for errors, the range of genes and the longest row, without keeping the matrix.
+ *
+ * @param filename The name of the file containing the matrix.
+ * @return Description of the matrix used to pick its store.
+ */
+MatrixResult scanMatrixFile(const std::string& filename);
+
+/**
+ * @brief Reads a matrix from a file straight into a population of the given row type.
+ *
+ * @param filename The name of the file containing the matrix.
+ * @param scan The result of scanMatrixFile for the file, every row must fit the row type.
+ * @return The population read from the file.
+ */
+template<typename Row>
+Population<Row> readMatrixFromFile(const std::string& filename, const MatrixResult& scan);
 
 /**
  * @brief Writes a matrix to a file.
  *
- * @param matrix The matrix to be written to the file.
+ * @param population The population to be written to the file.
  * @param filename The name of the file to write the matrix to.
  */
-void writeMatrixToFile(const std::vector<std::vector<int>>& matrix, const std::string& filename, double accuracy, int perfectFits);
+template<typename Row>
+void writeMatrixToFile(const Population<Row>& population, const std::string& filename, double accuracy, int perfectFits);
+
+/**
+ * @brief Writes the population to a binary file that can be memory mapped by PopulationFile.
+ *
+ * @param population The population to be written to the file.
+ * @param filename The name of the file to write the population to.
+ * @param accuracy Accuracy of the population.
+ * @param perfectFits Number of perfect fits in the population.
+ * @param generation Number of generations the population went through.
+ */
+template<typename Row>
+void writePopulationFile(const Population<Row>& population, const std::string& filename, double accuracy, int perfectFits, int generation);
 
 /**
  * @brief Opens the Notepad application with the specified file.
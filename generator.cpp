@@ -0,0 +1,471 @@
+/**
+ * @file generator.cpp
+ * @brief Native generator of synthetic populations, replacement of generator.py for big inputs.
+ */
+
+#include "generator.h"
+#include "commands.h"
+#include "messages.h"
+#include "population.h"
+#include "populationFile.h"
+#include "threadPool.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+/**
+ * @brief Parses a whole argument as an integer, unlike std::stoll which stops at the first wrong character.
+ *
+ * @param value The argument.
+ * @return The parsed number.
+ * @throws std::invalid_argument if the argument is not an integer, for example "1e8".
+ * @throws std::out_of_range if the number does not fit.
+ */
+
+static long long parseWholeInteger(const std::string& value)
+{
+    std::size_t parsed = 0;
+    long long number = std::stoll(value, &parsed);
+    if (parsed != value.size())
+    {
+        throw std::invalid_argument(value);
+    }
+    return number;
+}
+
+/**
+ * @brief Parses a whole argument as an int.
+ *
+ * @param value The argument.
+ * @return The parsed number.
+ * @throws std::invalid_argument if the argument is not an integer.
+ * @throws std::out_of_range if the number does not fit in an int.
+ */
+
+static int parseWholeInt(const std::string& value)
+{
+    long long number = parseWholeInteger(value);
+    if (number < INT_MIN || number > INT_MAX)
+    {
+        throw std::out_of_range(value);
+    }
+    return (int) number;
+}
+
+/**
+ * @brief Parses a whole argument as a double.
+ *
+ * @param value The argument.
+ * @return The parsed number.
+ * @throws std::invalid_argument if the argument is not a number.
+ * @throws std::out_of_range if the number does not fit.
+ */
+
+static double parseWholeDouble(const std::string& value)
+{
+    std::size_t parsed = 0;
+    double number = std::stod(value, &parsed);
+    if (parsed != value.size())
+    {
+        throw std::invalid_argument(value);
+    }
+    return number;
+}
+
+/**
+ * @brief Parses command-line arguments of the generator mode.
+ *
+ * @param argc Number of command line arguments.
+ * @param argv Array of command line argument strings, argv[1] is "generate".
+ * @return A structure containing the extracted parameters.
+ *
+ * The function uses the following command line options:
+ *   - "-o": Output file path.
+ *   - "-n": Number of rows (integer).
+ *   - "-l", "-L": The smallest and the biggest number of genes in a row (integers).
+ *   - "-d": Distribution of row lengths, "uniform" or "geometric".
+ *   - "-v", "-V": The smallest and the biggest gene value (integers, may be negative).
+ *   - "-s": Seed (integer).
+ *   - "-f": Format of the file, "text" or "binary".
+ *   - "-e": Fraction of empty rows (double).
+ *   - "-x": Fraction of very long rows (double).
+ *   - "-X": Number of genes of very long rows (integer).
+ *   - "-p": Fraction of genes written with '+' sign (double, text only).
+ *   - "-t", "-c": Number of worker threads and CPUs they are pinned to, like in the simulation.
+ *
+ * Example usage:
+ * @code
+ *   Darwin generate -o population.txt -n 100000000 -v -50 -V 50 -e 0.01 -s 7
+ * @endcode
+ */
+
+GeneratorParameters generator_input(int argc, char* argv[])
+{
+    GeneratorParameters params;
+
+    for (int i = 2; i + 1 < argc; i += 2) {
+        std::string arg = argv[i];
+        std::string value = argv[i + 1];
+
+        try {
+            if (arg == "-o") {
+                params.outputFile = value;
+            } else if (arg == "-n") {
+                params.rows = parseWholeInteger(value);
+            } else if (arg == "-l") {
+                params.minGenes = parseWholeInt(value);
+            } else if (arg == "-L") {
+                params.maxGenes = parseWholeInt(value);
+            } else if (arg == "-d") {
+                if (value == "uniform") {
+                    params.distribution = LengthDistribution::Uniform;
+                } else if (value == "geometric") {
+                    params.distribution = LengthDistribution::Geometric;
+                } else {
+                    printGeneratorError();
+                }
+            } else if (arg == "-v") {
+                params.minValue = parseWholeInt(value);
+            } else if (arg == "-V") {
+                params.maxValue = parseWholeInt(value);
+            } else if (arg == "-s") {
+                params.seed = parseWholeInteger(value);
+            } else if (arg == "-f") {
+                if (value != "text" && value != "binary") {
+                    printGeneratorError();
+                }
+                params.binary = value == "binary";
+            } else if (arg == "-e") {
+                params.emptyFraction = parseWholeDouble(value);
+            } else if (arg == "-x") {
+                params.longFraction = parseWholeDouble(value);
+            } else if (arg == "-X") {
+                params.longGenes = parseWholeInt(value);
+            } else if (arg == "-p") {
+                params.plusFraction = parseWholeDouble(value);
+            } else if (arg == "-t") {
+                params.threads = parseWholeInt(value);
+            } else if (arg == "-c") {
+                params.cpus = parseCpuList(value);
+            } else {
+                printGeneratorError();
+            }
+        } catch (const std::invalid_argument& e) {
+            printGeneratorError();
+        } catch (const std::out_of_range& e) {
+            printGeneratorError();
+        }
+    }
+
+    if (argc % 2 != 0 || params.outputFile.empty() || params.rows <= 0 || params.minGenes < 0 ||
+        params.maxGenes < params.minGenes || params.maxValue < params.minValue || params.longGenes < 0 ||
+        params.emptyFraction < 0.0 || params.longFraction < 0.0 || params.emptyFraction + params.longFraction > 1.0 ||
+        params.plusFraction < 0.0 || params.plusFraction > 1.0 || params.threads < 0) {
+        printGeneratorError();
+    }
+
+    return params;
+}
+
+namespace
+{
+    const long long rowsPerChunk = 1 << 16;
+
+    /**
+     * @brief Random streams of a single chunk of rows.
+     *
+     * Every chunk has its own streams derived from the seed and the chunk index, so chunks can be generated
+     * in any order on any number of threads. Lengths, values and signs use separate streams, so the text and the
+     * binary file contain the same population.
+     */
+    struct ChunkStreams
+    {
+        std::mt19937_64 lengths;
+        std::mt19937_64 values;
+        std::mt19937_64 signs;
+    };
+
+    std::mt19937_64 chunkStream(unsigned long long seed, long long chunk, unsigned int stream)
+    {
+        std::seed_seq sequence{(unsigned int) seed, (unsigned int) (seed >> 32),
+                               (unsigned int) chunk, (unsigned int) ((unsigned long long) chunk >> 32), stream};
+        return std::mt19937_64(sequence);
+    }
+
+    ChunkStreams chunkStreams(unsigned long long seed, long long chunk)
+    {
+        return ChunkStreams{chunkStream(seed, chunk, 0), chunkStream(seed, chunk, 1), chunkStream(seed, chunk, 2)};
+    }
+
+    /**
+     * @brief Draws the number of genes of the next row.
+     */
+    int drawLength(const GeneratorParameters& params, std::mt19937_64& lengths)
+    {
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+        double shape = unit(lengths);
+        if (shape < params.emptyFraction)
+        {
+            return 0;
+        }
+        if (shape < params.emptyFraction + params.longFraction)
+        {
+            return params.longGenes;
+        }
+
+        if (params.distribution == LengthDistribution::Geometric)
+        {
+            double mean = 1.0 + (params.maxGenes - params.minGenes) / 4.0;
+            std::geometric_distribution<int> extra(1.0 / mean);
+            return std::min(params.maxGenes, params.minGenes + extra(lengths));
+        }
+        std::uniform_int_distribution<int> uniform(params.minGenes, params.maxGenes);
+        return uniform(lengths);
+    }
+
+    long long chunkRowCount(const GeneratorParameters& params, long long chunk)
+    {
+        return std::min(rowsPerChunk, params.rows - chunk * rowsPerChunk);
+    }
+
+    /**
+     * @brief Generates the chunk as text in the format accepted by readMatrixFromFile.
+     */
+    std::string generateTextChunk(const GeneratorParameters& params, unsigned long long seed, long long chunk)
+    {
+        ChunkStreams streams = chunkStreams(seed, chunk);
+        std::uniform_int_distribution<int> gene(params.minValue, params.maxValue);
+        std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+        std::string text;
+        char number[16];
+        long long rows = chunkRowCount(params, chunk);
+        for (long long row = 0; row < rows; ++row)
+        {
+            int length = drawLength(params, streams.lengths);
+            for (int i = 0; i < length; ++i)
+            {
+                int value = gene(streams.values);
+                if (params.plusFraction > 0.0 && value >= 0 && unit(streams.signs) < params.plusFraction)
+                {
+                    text += '+';
+                }
+                char* last = std::to_chars(number, number + sizeof(number), value).ptr;
+                text.append(number, last);
+                text += ' ';
+            }
+            text += '\n';
+        }
+        return text;
+    }
+
+    /**
+     * @brief Genes, row lengths and sums of a chunk generated for the binary file.
+     */
+    template<typename Gene>
+    struct BinaryChunk
+    {
+        std::vector<std::uint64_t> lengths;
+        std::vector<std::int64_t> sums;
+        std::vector<Gene> genes;
+    };
+
+    template<typename Gene>
+    BinaryChunk<Gene> generateBinaryChunk(const GeneratorParameters& params, unsigned long long seed, long long chunk,
+                                          bool withGenes)
+    {
+        ChunkStreams streams = chunkStreams(seed, chunk);
+        std::uniform_int_distribution<int> gene(params.minValue, params.maxValue);
+
+        BinaryChunk<Gene> result;
+        long long rows = chunkRowCount(params, chunk);
+        result.lengths.reserve((std::size_t) rows);
+        for (long long row = 0; row < rows; ++row)
+        {
+            int length = drawLength(params, streams.lengths);
+            result.lengths.push_back((std::uint64_t) length);
+            if (withGenes && length > 0)
+            {
+                std::int64_t sum = 0;
+                for (int i = 0; i < length; ++i)
+                {
+                    int value = gene(streams.values);
+                    result.genes.push_back((Gene) value);
+                    sum += value;
+                }
+                result.sums.push_back(sum);
+            }
+        }
+        return result;
+    }
+
+    /**
+     * @brief Writes the binary population file with the layout described in populationFile.h.
+     *
+     * @details The first pass generates only row lengths to fill the offsets section and to find where rows and
+     * genes of every chunk start. The second pass generates genes of a batch of chunks in parallel and writes their
+     * sums and genes into their sections, so memory use does not depend on the number of rows (except for chunk
+     * offsets). Empty rows are skipped like in writePopulationFile, so the file holds only non-empty rows.
+     */
+    template<typename Gene>
+    void writeBinaryPopulation(const GeneratorParameters& params, unsigned long long seed, std::ofstream& file)
+    {
+        ThreadPool& pool = sharedPool();
+        long long chunkCount = (params.rows + rowsPerChunk - 1) / rowsPerChunk;
+        long long batchChunks = (long long) pool.size() * 2;
+
+        PopulationFileHeader header;
+        std::memcpy(header.magic, populationFileMagic, sizeof(header.magic));
+        header.version = populationFileVersion;
+        header.geneSize = sizeof(Gene);
+        header.offsetsStart = alignPopulationSection(sizeof(PopulationFileHeader));
+        header.accuracy = 0.0;
+        header.perfectFits = 0;
+        header.generation = 0;
+
+        std::vector<std::uint64_t> chunkRowStart(1, 0);
+        std::vector<std::uint64_t> chunkGeneStart(1, 0);
+        file.seekp((std::streamoff) header.offsetsStart);
+        for (long long first = 0; first < chunkCount; first += batchChunks)
+        {
+            long long count = std::min(batchChunks, chunkCount - first);
+            auto batch = runInChunks(pool, (std::size_t) count, 1, [&params, seed, first](std::size_t begin, std::size_t end)
+            {
+                std::vector<BinaryChunk<Gene>> chunks;
+                for (std::size_t chunk = begin; chunk < end; ++chunk)
+                {
+                    chunks.push_back(generateBinaryChunk<Gene>(params, seed, first + (long long) chunk, false));
+                }
+                return chunks;
+            });
+            for (auto& chunks : batch)
+            {
+                for (auto& chunk : chunks)
+                {
+                    std::vector<std::uint64_t> offsets;
+                    offsets.reserve(chunk.lengths.size());
+                    std::uint64_t offset = chunkGeneStart.back();
+                    for (std::uint64_t length : chunk.lengths)
+                    {
+                        if (length > 0)
+                        {
+                            offsets.push_back(offset);
+                            offset += length;
+                        }
+                    }
+                    file.write(reinterpret_cast<const char*>(offsets.data()), (std::streamsize) (offsets.size() * sizeof(std::uint64_t)));
+                    chunkRowStart.push_back(chunkRowStart.back() + offsets.size());
+                    chunkGeneStart.push_back(offset);
+                }
+            }
+        }
+        header.rowCount = chunkRowStart.back();
+        header.geneCount = chunkGeneStart.back();
+        header.sumsStart = alignPopulationSection(header.offsetsStart + (header.rowCount + 1) * sizeof(std::uint64_t));
+        header.genesStart = alignPopulationSection(header.sumsStart + header.rowCount * sizeof(std::int64_t));
+        file.write(reinterpret_cast<const char*>(&header.geneCount), sizeof(header.geneCount));
+
+        for (long long first = 0; first < chunkCount; first += batchChunks)
+        {
+            long long count = std::min(batchChunks, chunkCount - first);
+            auto batch = runInChunks(pool, (std::size_t) count, 1, [&params, seed, first](std::size_t begin, std::size_t end)
+            {
+                std::vector<BinaryChunk<Gene>> chunks;
+                for (std::size_t chunk = begin; chunk < end; ++chunk)
+                {
+                    chunks.push_back(generateBinaryChunk<Gene>(params, seed, first + (long long) chunk, true));
+                }
+                return chunks;
+            });
+            long long chunk = first;
+            for (auto& chunks : batch)
+            {
+                for (auto& generated : chunks)
+                {
+                    file.seekp((std::streamoff) (header.sumsStart + chunkRowStart[(std::size_t) chunk] * sizeof(std::int64_t)));
+                    file.write(reinterpret_cast<const char*>(generated.sums.data()), (std::streamsize) (generated.sums.size() * sizeof(std::int64_t)));
+                    file.seekp((std::streamoff) (header.genesStart + chunkGeneStart[(std::size_t) chunk] * sizeof(Gene)));
+                    file.write(reinterpret_cast<const char*>(generated.genes.data()), (std::streamsize) (generated.genes.size() * sizeof(Gene)));
+                    ++chunk;
+                }
+            }
+        }
+
+        const char padding = 0;
+        file.seekp((std::streamoff) (header.genesStart - 1)); // the file reaches the genes section even without genes
+        file.write(&padding, 1);
+        file.seekp(0);
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    }
+}
+
+/**
+ * @brief Generates the population in chunks on the shared thread pool and writes them in order.
+ *
+ * @param params Parameters of the population.
+ *
+ * @details Chunks are generated in batches of two per worker, so memory use stays small for any number of rows.
+ * The binary file uses the narrowest gene type fitting [minValue, maxValue], like the loader does.
+ */
+
+void generatePopulation(const GeneratorParameters& params)
+{
+    unsigned long long seed = params.seed >= 0 ? (unsigned long long) params.seed
+                              : (unsigned long long) std::chrono::high_resolution_clock::now().time_since_epoch().count();
+
+    std::ofstream file(params.outputFile, std::ios::binary);
+    if (!file.is_open())
+    {
+        std::cerr << RED BOLD << "Error: Unable to open file: " << params.outputFile << RESET << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    if (params.binary)
+    {
+        switch (narrowestGeneWidth(params.minValue, params.maxValue))
+        {
+            case GeneWidth::Int8:
+                writeBinaryPopulation<std::int8_t>(params, seed, file);
+                break;
+            case GeneWidth::Int16:
+                writeBinaryPopulation<std::int16_t>(params, seed, file);
+                break;
+            case GeneWidth::Int32:
+                writeBinaryPopulation<std::int32_t>(params, seed, file);
+                break;
+        }
+    }
+    else
+    {
+        ThreadPool& pool = sharedPool();
+        long long chunkCount = (params.rows + rowsPerChunk - 1) / rowsPerChunk;
+        long long batchChunks = (long long) pool.size() * 2;
+        for (long long first = 0; first < chunkCount; first += batchChunks)
+        {
+            long long count = std::min(batchChunks, chunkCount - first);
+            std::vector<std::string> texts = runInChunks(pool, (std::size_t) count, 1,
+                [&params, seed, first](std::size_t begin, std::size_t end)
+                {
+                    std::string text;
+                    for (std::size_t chunk = begin; chunk < end; ++chunk)
+                    {
+                        text += generateTextChunk(params, seed, first + (long long) chunk);
+                    }
+                    return text;
+                });
+            for (const auto& text : texts)
+            {
+                file.write(text.data(), (std::streamsize) text.size());
+            }
+        }
+    }
+
+    file.close();
+}
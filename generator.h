@@ -0,0 +1,62 @@
+#ifndef DARWIN_GENERATOR_H
+#define DARWIN_GENERATOR_H
+
+#include <string>
+#include <vector>
+
+/**
+ * @file generator.h
+ * @brief Declares the native generator of synthetic populations used for load testing.
+ */
+
+/**
+ * @brief Distribution of the number of genes in a row.
+ */
+enum class LengthDistribution
+{
+    Uniform,    ///< Every length from [minGenes, maxGenes] is equally likely.
+    Geometric   ///< Short rows are common and long ones rare, lengths start at minGenes and are cut at maxGenes.
+};
+
+/**
+ * @struct GeneratorParameters
+ * @brief Parameters of the generated population, defaults match generator.py.
+ */
+struct GeneratorParameters
+{
+    std::string outputFile;                                 ///< Path to the generated file.
+    long long rows = 0;                                     ///< Number of rows (organisms).
+    int minGenes = 2;                                       ///< The smallest number of genes in a row.
+    int maxGenes = 11;                                      ///< The biggest number of genes in a row.
+    LengthDistribution distribution = LengthDistribution::Uniform; ///< Distribution of row lengths.
+    int minValue = 0;                                       ///< The smallest gene value.
+    int maxValue = 99;                                      ///< The biggest gene value.
+    long long seed = -1;                                    ///< Seed, negative means the current time.
+    bool binary = false;                                    ///< Whether the binary population file is written.
+    double emptyFraction = 0.0;                             ///< Fraction of empty rows.
+    double longFraction = 0.0;                              ///< Fraction of very long rows.
+    int longGenes = 10000;                                  ///< Number of genes of very long rows.
+    double plusFraction = 0.0;                              ///< Fraction of genes written with '+' sign (text only).
+    int threads = 0;                                        ///< Number of worker threads, 0 means one per CPU.
+    std::vector<int> cpus;                                  ///< CPUs the worker threads are pinned to.
+};
+
+/**
+ * @brief Parses command-line arguments of the generator mode ("generate" as the first argument).
+ *
+ * @param argc Number of command-line arguments.
+ * @param argv Array of command-line arguments.
+ * @return The parsed parameters.
+ */
+GeneratorParameters generator_input(int argc, char* argv[]);
+
+/**
+ * @brief Generates the population and writes it in parallel to the output file.
+ *
+ * The same parameters and seed give the same population for any number of threads and for both formats.
+ *
+ * @param params Parameters of the population.
+ */
+void generatePopulation(const GeneratorParameters& params);
+
+#endif // DARWIN_GENERATOR_H
@@ -1,7 +1,10 @@
 #include "evolutionProcess.h"
+#include "convergenceMonitor.h"
 #include "fileOperations.h"
 #include "commands.h"
 #include "messages.h"
+#include "threadPool.h"
+#include "generator.h"
 
 /**
  * @file main.cpp
@@ -20,6 +23,7 @@
  * 1 23 481 1
  * Program reads all lines, select given amount of organisms and mix them (mutate).
  * After mutation of some creatures their capability to survive is checked by mathematical function.
+ * Simulation may stop earlier if accuracy reaches a plateau, the population goes extinct or explodes, or the time runs out.
  * Program repeats itself x times given by user in parameter.
  * After all processes of evolution matrix is saved to file in save template as users input file should look like.
  * At the end of the process function writes information that the program executed correctly if it did not error is printed.
@@ -27,27 +31,221 @@
  * Given input might be slightly imperfect.
  * For windows users its possible to open ready file in notepad
  * The program may be familiar to you under the name "Game of life".
+ * Started with "generate" as the first argument the program writes a synthetic population instead (see generator.h).
 */
 
+/**
+ * @brief State of the simulation kept across generations, also when the population changes its row type.
+ */
+
+struct Simulation
+{
+    explicit Simulation(const StopCriteria& criteria) : monitor(criteria) {}
+
+    ConvergenceMonitor monitor;
+    PopulationLimit limit;
+    MutationRates rates;
+    GenerationStats stats;
+    int generationsDone = 0;
+};
+
+/**
+ * @brief Prints statistics of the finished generation, saves a checkpoint and checks the stop criteria.
+ *
+ * @param p Parameters given by the user.
+ * @param sim State of the simulation.
+ * @param population The population after the generation.
+ * @param i Index of the generation.
+ * @return True if the simulation stops.
+ */
+
+template<typename Row>
+static bool finishGeneration(const Parameters& p, Simulation& sim, const Population<Row>& population, int i)
+{
+    sim.generationsDone = i + 1;
+    printGenerationStats(sim.stats);
+
+    if (p.checkpointInterval > 0 && (i + 1) % p.checkpointInterval == 0)
+    {
+        Results checkpoint = sim.stats.results();
+        writePopulationFile(population, p.binaryFile + ".gen" + std::to_string(i + 1), checkpoint.accuracy,
+                            checkpoint.perfectFits, i + 1);
+    }
+
+    StopReason reason = sim.monitor.update(sim.stats);
+    if (reason != StopReason::None)
+    {
+        printEarlyStop(describeStopReason(reason), i);
+        return true;
+    }
+    return false;
+}
+
+/**
+ * @brief Writes the final population to the output files.
+ *
+ * @param p Parameters given by the user.
+ * @param sim State of the simulation.
+ * @param population The final population.
+ */
+
+template<typename Row>
+static void writeResults(const Parameters& p, const Simulation& sim, const Population<Row>& population)
+{
+    Results result = sim.stats.results(); // gathered by the last fitting pass, no need to sum the rows again
+    writeMatrixToFile(population, p.outputFile, result.accuracy, result.perfectFits);
+    if (!p.binaryFile.empty())
+    {
+        writePopulationFile(population, p.binaryFile, result.accuracy, result.perfectFits, sim.generationsDone);
+    }
+}
+
+/**
+ * @brief Runs generations from the given one on and writes the final population.
+ *
+ * When a child outgrows the inline rows, the population continues as vector rows from the next generation on.
+ *
+ * @param p Parameters given by the user.
+ * @param sim State of the simulation.
+ * @param population The population.
+ * @param first Index of the first generation to run.
+ */
+
+template<typename Row>
+static void evolve(const Parameters& p, Simulation& sim, Population<Row>& population, int first)
+{
+    for (int i = first; i < p.generations; ++i)
+    {
+        Population<std::vector<typename Row::value_type>> widened;
+        population = pipelinedGeneration(population, p.pairsToCrossover, p.proliferationThreshold, p.extinctionThreshold,
+                                         i, sim.limit, sim.stats, sim.rates, &widened);
+        if constexpr (maxRowLength<Row> != SIZE_MAX)
+        {
+            if (!widened.segments.empty())
+            {
+                if (finishGeneration(p, sim, widened, i))
+                {
+                    writeResults(p, sim, widened);
+                }
+                else
+                {
+                    evolve(p, sim, widened, i + 1);
+                }
+                return;
+            }
+        }
+        if (finishGeneration(p, sim, population, i))
+        {
+            break;
+        }
+    }
+    writeResults(p, sim, population);
+}
+
+/**
+ * @brief Reads the population with the given row type and runs the whole simulation on it.
+ *
+ * @tparam Row The row type picked for the population.
+ * @param p Parameters given by the user.
+ * @param matrixResult The scanned input file.
+ */
+
+template<typename Row>
+void runSimulation(const Parameters& p, const MatrixResult& matrixResult)
+{
+    Population<Row> population = readMatrixFromFile<Row>(p.inputFile, matrixResult);
+
+    StopCriteria criteria;
+    criteria.plateauGenerations = p.plateauGenerations;
+    criteria.populationLimit = (std::size_t) p.populationLimit;
+    criteria.timeBudget = p.timeBudget;
+    Simulation sim(criteria);
+
+    sim.limit.maxPopulation = (std::size_t) p.maxPopulation;
+    sim.limit.memoryBudget = (std::size_t) (p.memoryBudget * 1024 * 1024);
+
+    sim.rates.point = p.pointRate;
+    sim.rates.insertion = p.insertionRate;
+    sim.rates.deletion = p.deletionRate;
+    sim.rates.swap = p.swapRate;
+    if (matrixResult.minGene <= matrixResult.maxGene) // new genes stay within the range of the gene type
+    {
+        sim.rates.minGene = matrixResult.minGene;
+        sim.rates.maxGene = matrixResult.maxGene;
+    }
+
+    evolve(p, sim, population, 0);
+}
+
+/**
+ * @brief Picks the row type for the gene type: the smallest inline genome the longest organism fits into,
+ * vector rows for longer organisms.
+ *
+ * @tparam Gene The gene type picked by the loader.
+ * @param p Parameters given by the user.
+ * @param matrixResult The scanned input file.
+ */
+
+template<typename Gene>
+void runSimulationWithGene(const Parameters& p, const MatrixResult& matrixResult)
+{
+    if (matrixResult.maxLength <= InlineGenome16<Gene>::maxLength)
+    {
+        runSimulation<InlineGenome16<Gene>>(p, matrixResult);
+    }
+    else if (matrixResult.maxLength <= InlineGenome32<Gene>::maxLength)
+    {
+        runSimulation<InlineGenome32<Gene>>(p, matrixResult);
+    }
+    else if (matrixResult.maxLength <= InlineGenome64<Gene>::maxLength)
+    {
+        runSimulation<InlineGenome64<Gene>>(p, matrixResult);
+    }
+    else
+    {
+        runSimulation<std::vector<Gene>>(p, matrixResult);
+    }
+}
+
 int main(int argc, char **argv)
 {
+    if (argc > 1 && std::string(argv[1]) == "generate") // synthetic population for load testing
+    {
+        GeneratorParameters generator = generator_input(argc, argv);
+        if (!configureSharedPool((std::size_t) generator.threads, generator.cpus))
+        {
+            printGeneratorError(); // a CPU from -c does not exist or is not allowed
+        }
+        generatePopulation(generator);
+        return 0;
+    }
+
     printStartMessage();
     Parameters p = user_input(argc, argv);
     printParameters(p.inputFile, p.outputFile, p.extinctionThreshold, p.proliferationThreshold, p.generations, p.pairsToCrossover);
-    MatrixResult matrixResult = readMatrixFromFile(p.inputFile);
-    std::vector<std::vector<int>> originalMatrix = matrixResult.matrix;
+    if (p.seed >= 0)
+    {
+        seedGenerator(static_cast<unsigned long long>(p.seed));
+    }
+    if (!configureSharedPool((std::size_t) p.threads, p.cpus, p.numaAware))
+    {
+        printError(); // a CPU from -c does not exist or is not allowed
+    }
+    MatrixResult matrixResult = scanMatrixFile(p.inputFile);
 
-    for (int i = 0; i < p.generations; ++i)
+    switch (matrixResult.geneWidth) // genes are stored in the narrowest type fitting the input range
     {
-        std::vector<std::vector<int>> pairsToCrossover = selectOrganism(originalMatrix, p.pairsToCrossover);
-        std::vector<std::vector<int>> pairsMutated = pairsForMutation(pairsToCrossover);
-        std::vector<std::vector<int>> mutationProcess = mutation(pairsMutated);
-        std::vector<std::vector<int>> connectedVectorOfOrganism = connectVectors(originalMatrix, mutationProcess);
-        std::vector<std::vector<int>> OrganismsAfterEvolution = fittedPopulation(connectedVectorOfOrganism, p.proliferationThreshold, p.extinctionThreshold, i);
-        originalMatrix = OrganismsAfterEvolution;
+        case GeneWidth::Int8:
+            runSimulationWithGene<std::int8_t>(p, matrixResult);
+            break;
+        case GeneWidth::Int16:
+            runSimulationWithGene<std::int16_t>(p, matrixResult);
+            break;
+        case GeneWidth::Int32:
+            runSimulationWithGene<std::int32_t>(p, matrixResult);
+            break;
     }
-    Results result = calculateAverageCosine(originalMatrix, p.proliferationThreshold);
-    writeMatrixToFile(originalMatrix, p.outputFile, result.accuracy, result.perfectFits);
+    printPoolStats(sharedPool().stats());
     printEndMessage();
     return 0;
 }
@@ -17,6 +17,30 @@ void printError()
     exit(EXIT_FAILURE);
 }
 
+/**
+ * @brief Prints error message for incorrect input of the generator mode.
+ */
+
+void printGeneratorError()
+{
+    std::cerr << "Execution error: Incorrect input of the generator." << std::endl;
+    std::cout << "\n" << YELLOW BOLD << "Short instruction of usage: \n" << RESET
+              << "The command should look like this: \n"
+              << RED BOLD << " \\Darwin_v3.exe generate -o \'your\\path\\to\\file.txt\' -n \'number of rows\' \n" << RESET
+              << "   -o - output file \n"
+              << "   -n - number of rows \n"
+              << "   -l, -L - optional smallest and biggest number of genes in a row (2 and 11 by default) \n"
+              << "   -d - optional distribution of row lengths, uniform or geometric \n"
+              << "   -v, -V - optional smallest and biggest gene value (0 and 99 by default) \n"
+              << "   -s - optional seed \n"
+              << "   -f - optional format, text or binary \n"
+              << "   -e - optional fraction of empty rows \n"
+              << "   -x, -X - optional fraction of very long rows and their number of genes \n"
+              << "   -p - optional fraction of genes written with '+' sign \n"
+              << "   -t, -c - optional number of worker threads and list of CPUs they are pinned to \n\n";
+    exit(EXIT_FAILURE);
+}
+
 /**
  * @brief Clears terminal, command is specified by system installed on machine.
  */
@@ -46,7 +70,22 @@ void printInstructionForWrongInput()
               << "   -w - extinction threshold - w belongs to set [0,1] \n"
               << "   -r - proliferation threshold - r belongs to set [0,1] \n"
               << "   -p - number of generations \n"
-              << "   -k - number k of pair to cross-over (its recommended to use number lower than the number of organisms)\n\n";
+              << "   -k - number k of pair to cross-over (its recommended to use number lower than the number of organisms)\n"
+              << "   -s - optional seed of the random generator, the same seed gives the same output \n"
+              << "   -t - optional number of worker threads, by default one per CPU \n"
+              << "   -c - optional list of CPUs the threads are pinned to, for example 0,2,4-7 \n"
+              << "   -n - optional NUMA-aware mode, 1 places threads and parts of the population on NUMA nodes \n"
+              << "   -a - optional number of generations without accuracy change after which the simulation stops \n"
+              << "   -x - optional population size above which the simulation stops \n"
+              << "   -b - optional time budget of the simulation in seconds \n"
+              << "   -m - optional maximal number of organisms, random organisms above it are removed \n"
+              << "   -g - optional memory budget of the population in megabytes \n"
+              << "   -B - optional binary output file with the population, readable by memory mapping \n"
+              << "   -C - optional number of generations between binary checkpoints saved as <B>.gen<number> \n"
+              << "   -mp - optional per-gene rate of point mutations of children \n"
+              << "   -mi - optional per-gene rate of gene insertions into children \n"
+              << "   -md - optional per-gene rate of gene deletions from children \n"
+              << "   -ms - optional per-gene rate of gene swaps inside children, the rates sum to at most 1 \n\n";
 }
 
 /**
@@ -116,6 +155,41 @@ void printParameters(const std::string& input, const std::string& output, double
               << CYAN << "\nExecuting program..." << RESET << "\n";
 }
 
+/**
+ * @brief Prints statistics of the population after a generation.
+ */
+
+void printGenerationStats(const GenerationStats& stats)
+{
+    std::cout << "Population: " << stats.population << "\n"
+              << "Accuracy: " << stats.accuracy() * 100 << "%\n"
+              << "Perfect fits: " << stats.perfectFits << "\n"
+              << "Gene diversity: " << stats.geneDiversity() << "\n\n";
+}
+
+/**
+ * @brief Prints why the simulation stopped before the last generation.
+ */
+
+void printEarlyStop(const char* reason, int generation)
+{
+    std::cout << YELLOW BOLD << "Simulation stopped after generation " << generation + 1 << ": " << reason << RESET << "\n\n";
+}
+
+/**
+ * @brief Prints utilization of the shared thread pool.
+ */
+
+void printPoolStats(const PoolStats& stats)
+{
+    std::cout << YELLOW << "Thread pool: \n"
+              << BOLD << " - Threads: \'" << stats.threads << "\'\n"
+              << " - NUMA nodes: \'" << stats.nodes << "\'\n"
+              << " - Tasks executed: \'" << stats.tasksExecuted << "\'\n"
+              << " - Tasks stolen: \'" << stats.tasksStolen << "\'\n"
+              << " - Utilization: \'" << stats.utilization * 100 << "%\'\n" << RESET;
+}
+
 /**
  * @brief Prints message if program was executed correctly.
  */
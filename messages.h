@@ -2,6 +2,8 @@
 #define DARWIN_V3_MESSAGES_H
 
 #include "commands.h"
+#include "threadPool.h"
+#include "evolutionProcess.h"
 
 #define RESET   "\033[0m"
 #define RED     "\033[31m"
@@ -21,6 +23,11 @@
  */
 void printError();
 
+/**
+ * @brief Prints an error message for the generator mode.
+ */
+void printGeneratorError();
+
 /**
  * @brief Clears the console screen.
  */
@@ -53,6 +60,28 @@ void printStartMessage();
  */
 void printParameters(const std::string& inputFile, const std::string& outputFile, double extinctionThreshold, double proliferationThreshold, int generations, int pairsToCrossOver);
 
+/**
+ * @brief Prints statistics of the population after a generation.
+ *
+ * @param stats Statistics gathered by the fitting pass.
+ */
+void printGenerationStats(const GenerationStats& stats);
+
+/**
+ * @brief Prints why the simulation stopped before the last generation.
+ *
+ * @param reason Description of the stop reason.
+ * @param generation Index of the last generation.
+ */
+void printEarlyStop(const char* reason, int generation);
+
+/**
+ * @brief Prints utilization of the shared thread pool.
+ *
+ * @param stats Statistics returned by ThreadPool::stats.
+ */
+void printPoolStats(const PoolStats& stats);
+
 /**
  * @brief Prints the end message for the simulation.
  */
@@ -0,0 +1,114 @@
+/**
+ * @file numa.cpp
+ * @brief Implementation of NUMA node detection.
+ */
+
+#include "numa.h"
+#include "commands.h"
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+/**
+ * @brief Reads nodes from /sys/devices/system/node, falls back to a single node with every CPU.
+ *
+ * @return Nodes of the machine, never empty.
+ */
+
+std::vector<NumaNode> detectNumaNodes()
+{
+    std::vector<NumaNode> nodes;
+
+    #ifdef __linux__
+        std::ifstream online("/sys/devices/system/node/online");
+        std::string onlineList;
+        if (online.is_open() && std::getline(online, onlineList))
+        {
+            try
+            {
+                for (int id : parseCpuList(onlineList)) // the list of nodes uses the same format as the list of CPUs
+                {
+                    std::ifstream cpuList("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist");
+                    std::string cpus;
+                    if (cpuList.is_open() && std::getline(cpuList, cpus) && !cpus.empty())
+                    {
+                        nodes.push_back(NumaNode{id, parseCpuList(cpus)});
+                    }
+                }
+            }
+            catch (const std::invalid_argument& e)
+            {
+                nodes.clear();
+            }
+        }
+    #endif
+
+    if (nodes.empty())
+    {
+        NumaNode single{0, {}};
+        unsigned int cpuCount = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned int cpu = 0; cpu < cpuCount; ++cpu)
+        {
+            single.cpus.push_back((int) cpu);
+        }
+        nodes.push_back(single);
+    }
+    return nodes;
+}
+
+/**
+ * @brief Spreads workers evenly over NUMA nodes and pins each one to a CPU of its node.
+ *
+ * @param threadCount Number of workers, 0 means one per allowed CPU.
+ * @param allowedCpus CPUs the workers may use, empty means every CPU.
+ * @param workerCpus CPU of every worker.
+ * @param workerNodes Node of every worker, numbered from 0.
+ *
+ * @details Nodes without any allowed CPU are skipped. Worker i goes to node i % nodeCount and takes the next CPU
+ * of that node, so nodes get the same number of workers (plus or minus one) whatever the thread count is.
+ */
+
+void placeWorkersOnNodes(std::size_t threadCount, const std::vector<int>& allowedCpus,
+                         std::vector<int>& workerCpus, std::vector<int>& workerNodes)
+{
+    std::vector<std::vector<int>> nodeCpus;
+    for (const auto& node : detectNumaNodes())
+    {
+        std::vector<int> cpus;
+        for (int cpu : node.cpus)
+        {
+            if (allowedCpus.empty() || std::find(allowedCpus.begin(), allowedCpus.end(), cpu) != allowedCpus.end())
+            {
+                cpus.push_back(cpu);
+            }
+        }
+        if (!cpus.empty())
+        {
+            nodeCpus.push_back(cpus);
+        }
+    }
+    if (nodeCpus.empty()) // allowed CPUs are not known to the system, keep them on one node
+    {
+        nodeCpus.push_back(allowedCpus);
+    }
+
+    if (threadCount == 0)
+    {
+        for (const auto& cpus : nodeCpus)
+        {
+            threadCount += cpus.size();
+        }
+    }
+
+    workerCpus.clear();
+    workerNodes.clear();
+    for (std::size_t i = 0; i < threadCount; ++i)
+    {
+        std::size_t node = i % nodeCpus.size();
+        const std::vector<int>& cpus = nodeCpus[node];
+        workerCpus.push_back(cpus.empty() ? -1 : cpus[(i / nodeCpus.size()) % cpus.size()]);
+        workerNodes.push_back((int) node);
+    }
+}
@@ -0,0 +1,44 @@
+#ifndef DARWIN_NUMA_H
+#define DARWIN_NUMA_H
+
+#include <vector>
+
+/**
+ * @file numa.h
+ * @brief Declares detection of NUMA nodes used to place worker threads of the thread pool.
+ */
+
+/**
+ * @struct NumaNode
+ * @brief A single NUMA node with its CPUs.
+ */
+struct NumaNode
+{
+    int id;                 ///< Number of the node given by the system.
+    std::vector<int> cpus;  ///< CPUs belonging to the node.
+};
+
+/**
+ * @brief Detects NUMA nodes of the machine.
+ *
+ * On machines without NUMA, or on systems where the topology can not be read, a single node
+ * containing every CPU is returned.
+ *
+ * @return Nodes of the machine, never empty.
+ */
+std::vector<NumaNode> detectNumaNodes();
+
+/**
+ * @brief Places worker threads on NUMA nodes.
+ *
+ * Workers are spread evenly over the nodes and pinned to their CPUs, so every node gets its own workers.
+ *
+ * @param threadCount Number of workers, 0 means one per allowed CPU.
+ * @param allowedCpus CPUs the workers may use, empty means every CPU.
+ * @param workerCpus CPU of every worker.
+ * @param workerNodes Node of every worker, numbered from 0.
+ */
+void placeWorkersOnNodes(std::size_t threadCount, const std::vector<int>& allowedCpus,
+                         std::vector<int>& workerCpus, std::vector<int>& workerNodes);
+
+#endif // DARWIN_NUMA_H
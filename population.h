@@ -0,0 +1,226 @@
+#ifndef DARWIN_POPULATION_H
+#define DARWIN_POPULATION_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @file population.h
+ * @brief Declares the population storage shared by the loader, the evolution process and the writer.
+ */
+
+/**
+ * @brief Population stored as rows of genes, every row is a single organism.
+ *
+ * @tparam Gene Integer type of a single gene (int8_t, int16_t or int32_t).
+ */
+template<typename Gene>
+using Matrix = std::vector<std::vector<Gene>>;
+
+/**
+ * @brief Width of the gene type picked for the loaded population.
+ */
+enum class GeneWidth
+{
+    Int8,
+    Int16,
+    Int32
+};
+
+/**
+ * @brief Returns the narrowest gene width able to hold every value from [minGene, maxGene].
+ *
+ * @param minGene The smallest gene found in the population.
+ * @param maxGene The biggest gene found in the population.
+ * @return The narrowest gene width.
+ */
+inline GeneWidth narrowestGeneWidth(int minGene, int maxGene)
+{
+    if (minGene >= INT8_MIN && maxGene <= INT8_MAX)
+    {
+        return GeneWidth::Int8;
+    }
+    if (minGene >= INT16_MIN && maxGene <= INT16_MAX)
+    {
+        return GeneWidth::Int16;
+    }
+    return GeneWidth::Int32;
+}
+
+/**
+ * @brief Number of organisms in the smallest chunk the population is split into by the thread pool.
+ */
+constexpr std::size_t populationChunkSize = 4096;
+
+/**
+ * @brief Returns the size of an InlineGenome: the length padded to the gene alignment followed by the genes,
+ * rounded up to a power of two.
+ *
+ * @param geneSize Size of a single gene in bytes.
+ * @param maxLength Maximal number of genes.
+ */
+constexpr std::size_t inlineGenomeBytes(std::size_t geneSize, std::size_t maxLength)
+{
+    std::size_t bytes = 1;
+    while (bytes < geneSize + maxLength * geneSize)
+    {
+        bytes *= 2;
+    }
+    return bytes;
+}
+
+/**
+ * @brief Returns the maximal length of an InlineGenome taking the given number of bytes.
+ *
+ * The length is even, so a child made of the longer halves of two genomes that fit always fits too, only
+ * insertions can make an organism outgrow it.
+ *
+ * @param geneSize Size of a single gene in bytes.
+ * @param bytes Size of the genome, a power of two.
+ */
+constexpr std::size_t inlineGenomeLength(std::size_t geneSize, std::size_t bytes)
+{
+    return (bytes - geneSize) / geneSize / 2 * 2;
+}
+
+/**
+ * @brief Organism stored inline with a bounded length.
+ *
+ * A row of a Matrix keeps its genes in a separate heap block behind a 24-byte vector header. An inline genome
+ * keeps its length and genes in a single record aligned to its size, so a segment of such organisms is one flat
+ * contiguous array, every genome sits in a single cache line and passes over the population read memory
+ * sequentially. It offers the part of the vector interface used by the evolution process and the writers.
+ *
+ * @tparam Gene Integer type of a single gene (int8_t, int16_t or int32_t).
+ * @tparam MaxLength Maximal number of genes.
+ */
+template<typename Gene, std::size_t MaxLength>
+struct alignas(inlineGenomeBytes(sizeof(Gene), MaxLength)) InlineGenome
+{
+    static_assert(MaxLength <= UINT8_MAX, "the length of an inline genome is stored in a single byte");
+
+    using value_type = Gene;
+    static constexpr std::size_t maxLength = MaxLength;
+
+    std::uint8_t length;
+    Gene genes[MaxLength];
+
+    std::size_t size() const { return length; }
+    bool empty() const { return length == 0; }
+    const Gene* data() const { return genes; }
+    const Gene* begin() const { return genes; }
+    const Gene* end() const { return genes + length; }
+    Gene& operator[](std::size_t index) { return genes[index]; }
+    const Gene& operator[](std::size_t index) const { return genes[index]; }
+
+    /**
+     * @brief Replaces the genes, [first, last) must not be longer than MaxLength.
+     */
+    template<typename Iterator>
+    void assign(Iterator first, Iterator last)
+    {
+        length = 0;
+        for (; first != last; ++first)
+        {
+            genes[length++] = (Gene) *first;
+        }
+    }
+
+    /**
+     * @brief Copies genes of a row built as a vector, for example a child, which must fit.
+     */
+    InlineGenome& operator=(const std::vector<Gene>& row)
+    {
+        assign(row.begin(), row.end());
+        return *this;
+    }
+};
+
+/**
+ * @brief Inline genomes of 16, 32 and 64 bytes picked by the loader for short organisms.
+ */
+template<typename Gene>
+using InlineGenome16 = InlineGenome<Gene, inlineGenomeLength(sizeof(Gene), 16)>;
+template<typename Gene>
+using InlineGenome32 = InlineGenome<Gene, inlineGenomeLength(sizeof(Gene), 32)>;
+template<typename Gene>
+using InlineGenome64 = InlineGenome<Gene, inlineGenomeLength(sizeof(Gene), 64)>;
+
+static_assert(sizeof(InlineGenome16<std::int8_t>) == 16 && sizeof(InlineGenome64<std::int32_t>) == 64,
+              "an inline genome takes exactly the bytes it is named after");
+
+/**
+ * @brief Maximal number of genes a row of the given type can hold.
+ */
+template<typename Row>
+constexpr std::size_t maxRowLength = SIZE_MAX;
+template<typename Gene, std::size_t MaxLength>
+constexpr std::size_t maxRowLength<InlineGenome<Gene, MaxLength>> = MaxLength;
+
+/**
+ * @brief Expands the macro for every row type of the gene, used by explicit instantiations.
+ */
+#define FOR_EACH_ROW_TYPE(MACRO, Gene) \
+    MACRO(std::vector<Gene>) \
+    MACRO(InlineGenome16<Gene>) \
+    MACRO(InlineGenome32<Gene>) \
+    MACRO(InlineGenome64<Gene>)
+
+/**
+ * @brief Population split into segments, one per NUMA node of the shared thread pool.
+ *
+ * Rows of a segment and their genes are allocated on the segment's node and stay there: organisms kept by
+ * a generation remain in their segment and children are added to the segment of one of their parents.
+ * Global indices of organisms count the rows of the first segment first, then the second one and so on.
+ *
+ * @tparam Row Type of a single organism: std::vector of genes or an InlineGenome.
+ */
+template<typename Row>
+struct Population
+{
+    std::vector<std::vector<Row>> segments;     ///< Segment i lives on NUMA node i.
+
+    /**
+     * @brief Returns the number of organisms in all segments.
+     */
+    std::size_t size() const
+    {
+        std::size_t count = 0;
+        for (const std::vector<Row>& segment : segments)
+        {
+            count += segment.size();
+        }
+        return count;
+    }
+
+    /**
+     * @brief Returns the segment holding the organism with the given global index.
+     */
+    std::size_t segmentOf(std::size_t index) const
+    {
+        std::size_t segment = 0;
+        while (index >= segments[segment].size())
+        {
+            index -= segments[segment].size();
+            ++segment;
+        }
+        return segment;
+    }
+
+    /**
+     * @brief Returns the organism with the given global index.
+     */
+    const Row& operator[](std::size_t index) const
+    {
+        std::size_t segment = 0;
+        while (index >= segments[segment].size())
+        {
+            index -= segments[segment].size();
+            ++segment;
+        }
+        return segments[segment][index];
+    }
+};
+
+#endif // DARWIN_POPULATION_H
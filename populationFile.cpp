@@ -0,0 +1,137 @@
+/**
+ * @file populationFile.cpp
+ * @brief Implementation of the read-only mapping of the binary population file.
+ */
+
+#include "populationFile.h"
+#include <cstring>
+#ifdef WIN32
+    #include <windows.h>
+#else
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <sys/stat.h>
+    #include <unistd.h>
+#endif
+
+/**
+ * @brief Maps the whole file read-only and checks that every section lies inside it.
+ *
+ * @param filename Path to the binary population file.
+ *
+ * @details Pages are loaded by the system on first access, so opening a big file is cheap and several processes
+ * mapping the same file share its pages in the page cache. Only the header, the first and the last offset are
+ * checked here, offsets of single rows are checked when the rows are read.
+ */
+
+PopulationFile::PopulationFile(const std::string& filename)
+{
+    #ifdef WIN32
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                  FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (file == INVALID_HANDLE_VALUE)
+        {
+            throw std::runtime_error("Unable to open population file: " + filename);
+        }
+        LARGE_INTEGER size;
+        GetFileSizeEx(file, &size);
+        mappingSize = (std::size_t) size.QuadPart;
+        HANDLE view = mappingSize > 0 ? CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr) : nullptr;
+        mapping = view != nullptr ? MapViewOfFile(view, FILE_MAP_READ, 0, 0, 0) : nullptr;
+        fileHandle = file;
+        mappingHandle = view;
+    #else
+        int file = open(filename.c_str(), O_RDONLY);
+        if (file < 0)
+        {
+            throw std::runtime_error("Unable to open population file: " + filename);
+        }
+        struct stat status;
+        fstat(file, &status);
+        mappingSize = (std::size_t) status.st_size;
+        if (mappingSize > 0)
+        {
+            mapping = mmap(nullptr, mappingSize, PROT_READ, MAP_SHARED, file, 0);
+            if (mapping == MAP_FAILED)
+            {
+                mapping = nullptr;
+            }
+        }
+        close(file); // the mapping stays valid after closing the descriptor
+    #endif
+
+    if (mapping == nullptr || mappingSize < sizeof(PopulationFileHeader))
+    {
+        unmap();
+        throw std::runtime_error("Unable to map population file: " + filename);
+    }
+
+    const unsigned char* bytes = static_cast<const unsigned char*>(mapping);
+    fileHeader = reinterpret_cast<const PopulationFileHeader*>(bytes);
+    const PopulationFileHeader& h = *fileHeader;
+
+    // counts are compared with the file size before they are multiplied, so a corrupt header can not overflow
+    std::uint64_t size = mappingSize;
+    bool valid = std::memcmp(h.magic, populationFileMagic, sizeof(populationFileMagic)) == 0
+                 && h.version == populationFileVersion
+                 && (h.geneSize == 1 || h.geneSize == 2 || h.geneSize == 4)
+                 && h.offsetsStart % populationFileAlignment == 0
+                 && h.sumsStart % populationFileAlignment == 0
+                 && h.genesStart % populationFileAlignment == 0
+                 && h.offsetsStart >= sizeof(PopulationFileHeader)
+                 && h.offsetsStart <= size && h.sumsStart <= size && h.genesStart <= size
+                 && h.rowCount < size / sizeof(std::uint64_t)
+                 && h.geneCount <= size / h.geneSize
+                 && h.offsetsStart + (h.rowCount + 1) * sizeof(std::uint64_t) <= h.sumsStart
+                 && h.sumsStart + h.rowCount * sizeof(std::int64_t) <= h.genesStart
+                 && h.genesStart + h.geneCount * h.geneSize <= size;
+    if (valid)
+    {
+        const std::uint64_t* fileOffsets = reinterpret_cast<const std::uint64_t*>(bytes + h.offsetsStart);
+        valid = fileOffsets[0] == 0 && fileOffsets[h.rowCount] == h.geneCount;
+    }
+    if (!valid)
+    {
+        unmap();
+        throw std::runtime_error("Not a valid population file: " + filename);
+    }
+
+    offsets = reinterpret_cast<const std::uint64_t*>(bytes + h.offsetsStart);
+    rowSums = reinterpret_cast<const std::int64_t*>(bytes + h.sumsStart);
+    genesBegin = bytes + h.genesStart;
+}
+
+PopulationFile::~PopulationFile()
+{
+    unmap();
+}
+
+/**
+ * @brief Releases the mapping and the handles, safe to call more than once.
+ */
+
+void PopulationFile::unmap()
+{
+    #ifdef WIN32
+        if (mapping != nullptr)
+        {
+            UnmapViewOfFile(mapping);
+        }
+        if (mappingHandle != nullptr)
+        {
+            CloseHandle(mappingHandle);
+        }
+        if (fileHandle != nullptr)
+        {
+            CloseHandle(fileHandle);
+        }
+        mappingHandle = nullptr;
+        fileHandle = nullptr;
+    #else
+        if (mapping != nullptr)
+        {
+            munmap(mapping, mappingSize);
+        }
+    #endif
+    mapping = nullptr;
+}
@@ -0,0 +1,189 @@
+#ifndef DARWIN_POPULATION_FILE_H
+#define DARWIN_POPULATION_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+
+/**
+ * @file populationFile.h
+ * @brief Declares the binary population file and the read-only API mapping it into memory.
+ *
+ * The file can be opened by analysis tools without parsing text: rows, their lengths and their sums are read
+ * directly from the mapped pages. This header does not depend on the rest of the simulator.
+ *
+ * Layout of the file (native byte order, every section aligned to 64 bytes):
+ *   - PopulationFileHeader
+ *   - uint64_t offsets[rowCount + 1], index of the first gene of every row, the last one equals geneCount
+ *   - int64_t rowSums[rowCount], sum of genes of every row
+ *   - genes of all rows one after another, geneSize bytes each
+ *
+ * Both writers (the simulation and the generator) skip empty organisms, like the text output does.
+ */
+
+/**
+ * @struct PopulationFileHeader
+ * @brief Header at the beginning of the binary population file.
+ */
+struct PopulationFileHeader
+{
+    char magic[8];              ///< "DRWNPOP" followed by a null character.
+    std::uint32_t version;      ///< Version of the layout, currently 1.
+    std::uint32_t geneSize;     ///< Size of a single gene in bytes: 1, 2 or 4.
+    std::uint64_t rowCount;     ///< Number of organisms.
+    std::uint64_t geneCount;    ///< Number of genes of all organisms.
+    std::uint64_t offsetsStart; ///< Position of the offsets section in the file.
+    std::uint64_t sumsStart;    ///< Position of the row sums section in the file.
+    std::uint64_t genesStart;   ///< Position of the genes section in the file.
+    double accuracy;            ///< Accuracy of the population, the same as in the text output.
+    std::int64_t perfectFits;   ///< Number of perfect fits, the same as in the text output.
+    std::int64_t generation;    ///< Number of generations the population went through.
+};
+
+constexpr char populationFileMagic[8] = {'D', 'R', 'W', 'N', 'P', 'O', 'P', '\0'};
+constexpr std::uint32_t populationFileVersion = 1;
+constexpr std::uint64_t populationFileAlignment = 64;
+
+/**
+ * @brief Rounds the position in the file up to the section alignment.
+ */
+inline std::uint64_t alignPopulationSection(std::uint64_t position)
+{
+    return (position + populationFileAlignment - 1) / populationFileAlignment * populationFileAlignment;
+}
+
+/**
+ * @struct RowView
+ * @brief Organism read directly from the mapped file, valid as long as the file is open.
+ */
+template<typename Gene>
+struct RowView
+{
+    const Gene* genes;      ///< First gene of the organism.
+    std::size_t length;     ///< Number of genes.
+    std::int64_t sum;       ///< Sum of genes computed when the file was written.
+
+    const Gene* begin() const { return genes; }
+    const Gene* end() const { return genes + length; }
+    std::size_t size() const { return length; }
+    Gene operator[](std::size_t index) const { return genes[index]; }
+};
+
+/**
+ * @class PopulationFile
+ * @brief Read-only memory mapping of the binary population file.
+ *
+ * Example usage:
+ * @code
+ *   PopulationFile population("output.pop");
+ *   for (std::size_t i = 0; i < population.rowCount(); ++i)
+ *   {
+ *       RowView<std::int8_t> row = population.row<std::int8_t>(i);
+ *   }
+ * @endcode
+ */
+class PopulationFile
+{
+public:
+    /**
+     * @brief Maps the file into memory and validates its header.
+     *
+     * @param filename Path to the binary population file.
+     * @throws std::runtime_error if the file can not be mapped or it is not a valid population file.
+     */
+    explicit PopulationFile(const std::string& filename);
+
+    /**
+     * @brief Unmaps the file, row views become invalid.
+     */
+    ~PopulationFile();
+
+    PopulationFile(const PopulationFile&) = delete;
+    PopulationFile& operator=(const PopulationFile&) = delete;
+
+    const PopulationFileHeader& header() const { return *fileHeader; }
+    std::size_t rowCount() const { return (std::size_t) fileHeader->rowCount; }
+    std::size_t geneCount() const { return (std::size_t) fileHeader->geneCount; }
+    std::size_t geneSize() const { return fileHeader->geneSize; }
+    double accuracy() const { return fileHeader->accuracy; }
+    std::int64_t perfectFits() const { return fileHeader->perfectFits; }
+
+    /**
+     * @brief Returns number of genes of the organism.
+     *
+     * @throws std::out_of_range if the index is not smaller than rowCount().
+     * @throws std::runtime_error if offsets of the organism are corrupt.
+     */
+    std::size_t rowLength(std::size_t index) const
+    {
+        checkRow(index);
+        return (std::size_t) (offsets[index + 1] - offsets[index]);
+    }
+
+    /**
+     * @brief Returns sum of genes of the organism, precomputed by the writer.
+     *
+     * @throws std::out_of_range if the index is not smaller than rowCount().
+     */
+    std::int64_t rowSum(std::size_t index) const
+    {
+        if (index >= fileHeader->rowCount)
+        {
+            throw std::out_of_range("Row index out of range of the population file");
+        }
+        return rowSums[index];
+    }
+
+    /**
+     * @brief Returns the organism without copying its genes.
+     *
+     * @tparam Gene Gene type matching geneSize().
+     * @param index Index of the organism.
+     * @throws std::invalid_argument if the size of Gene does not match the file.
+     * @throws std::out_of_range if the index is not smaller than rowCount().
+     * @throws std::runtime_error if offsets of the organism are corrupt.
+     */
+    template<typename Gene>
+    RowView<Gene> row(std::size_t index) const
+    {
+        if (sizeof(Gene) != fileHeader->geneSize)
+        {
+            throw std::invalid_argument("Gene type does not match the population file");
+        }
+        std::size_t length = rowLength(index);
+        const Gene* genes = reinterpret_cast<const Gene*>(genesBegin) + offsets[index];
+        return RowView<Gene>{genes, length, rowSums[index]};
+    }
+
+private:
+    void unmap();
+
+    /**
+     * @brief Checks the index and offsets of a single organism, so offsets of the whole file are never scanned.
+     */
+    void checkRow(std::size_t index) const
+    {
+        if (index >= fileHeader->rowCount)
+        {
+            throw std::out_of_range("Row index out of range of the population file");
+        }
+        if (offsets[index] > offsets[index + 1] || offsets[index + 1] > fileHeader->geneCount)
+        {
+            throw std::runtime_error("Corrupt offsets in the population file");
+        }
+    }
+
+    void* mapping = nullptr;
+    std::size_t mappingSize = 0;
+    #ifdef WIN32
+        void* fileHandle = nullptr;
+        void* mappingHandle = nullptr;
+    #endif
+    const PopulationFileHeader* fileHeader = nullptr;
+    const std::uint64_t* offsets = nullptr;
+    const std::int64_t* rowSums = nullptr;
+    const unsigned char* genesBegin = nullptr;
+};
+
+#endif // DARWIN_POPULATION_FILE_H
@@ -0,0 +1,363 @@
+/**
+ * @file threadPool.cpp
+ * @brief Implementation of the work-stealing thread pool.
+ */
+
+#include "threadPool.h"
+#include "numa.h"
+#include <algorithm>
+#ifdef __linux__
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+namespace
+{
+    thread_local const ThreadPool* currentPool = nullptr;   ///< Pool owning the current thread, if it is a worker.
+    thread_local std::size_t currentWorker = 0;             ///< Index of the current worker in its pool.
+
+    std::unique_ptr<ThreadPool> sharedInstance;
+    std::mutex sharedInstanceMutex;
+
+    /**
+     * @brief Pins the thread to a single CPU, does nothing on systems without affinity support.
+     *
+     * @return False if the CPU does not exist or the process is not allowed to run on it.
+     */
+
+    bool pinThread(std::thread& thread, int cpu)
+    {
+        #ifdef __linux__
+            if (cpu >= CPU_SETSIZE)
+            {
+                return false;
+            }
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET(cpu, &set);
+            return pthread_setaffinity_np(thread.native_handle(), sizeof(set), &set) == 0;
+        #else
+            (void) thread;
+            (void) cpu;
+            return true;
+        #endif
+    }
+}
+
+/**
+ * @brief Starts the workers and pins them to the given CPUs.
+ *
+ * @param threadCount Number of workers, 0 means one per CPU from the affinity list or one per hardware thread.
+ * @param cpus CPUs the workers are pinned to, negative numbers are not pinned.
+ * @param nodes NUMA nodes of the workers.
+ */
+
+ThreadPool::ThreadPool(std::size_t threadCount, const std::vector<int>& cpus, const std::vector<int>& nodes)
+    : started(std::chrono::steady_clock::now())
+{
+    if (threadCount == 0)
+    {
+        threadCount = cpus.empty() ? std::max(1u, std::thread::hardware_concurrency()) : cpus.size();
+    }
+
+    for (std::size_t i = 0; i < threadCount; ++i)
+    {
+        workers.push_back(std::make_unique<Worker>());
+        workers[i]->node = nodes.empty() ? 0 : nodes[i % nodes.size()];
+        if (nodeWorkers.size() <= (std::size_t) workers[i]->node)
+        {
+            nodeWorkers.resize(workers[i]->node + 1);
+        }
+        nodeWorkers[workers[i]->node].push_back(i);
+    }
+    pendingOnNode = std::make_unique<std::atomic<std::size_t>[]>(nodeWorkers.size());
+    for (std::size_t node = 0; node < nodeWorkers.size(); ++node)
+    {
+        pendingOnNode[node] = 0;
+    }
+    for (std::size_t i = 0; i < threadCount; ++i)
+    {
+        workers[i]->thread = std::thread(&ThreadPool::workerLoop, this, i);
+        if (!cpus.empty() && cpus[i % cpus.size()] >= 0)
+        {
+            if (!pinThread(workers[i]->thread, cpus[i % cpus.size()]))
+            {
+                unpinnedCpus.push_back(cpus[i % cpus.size()]);
+            }
+        }
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers)
+    {
+        worker->thread.join();
+    }
+}
+
+std::size_t ThreadPool::size() const
+{
+    return workers.size();
+}
+
+std::size_t ThreadPool::nodeCount() const
+{
+    return nodeWorkers.size();
+}
+
+const std::vector<int>& ThreadPool::pinningFailures() const
+{
+    return unpinnedCpus;
+}
+
+/**
+ * @brief Sums counters of all workers.
+ *
+ * @return Number of threads and NUMA nodes, executed and stolen tasks, and busy time of workers divided by their lifetime.
+ */
+
+PoolStats ThreadPool::stats() const
+{
+    PoolStats result{workers.size(), nodeWorkers.size(), executedOutside.load(), 0, 0.0};
+    long long busy = 0;
+    for (const auto& worker : workers)
+    {
+        result.tasksExecuted += worker->executed.load();
+        result.tasksStolen += worker->stolen.load();
+        busy += worker->busyNanoseconds.load();
+    }
+    auto lifetime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - started).count();
+    if (lifetime > 0 && !workers.empty())
+    {
+        result.utilization = std::min(1.0, (double) busy / ((double) lifetime * (double) workers.size()));
+    }
+    return result;
+}
+
+/**
+ * @brief Puts the task into the queue of the current worker, or into the next queue for threads outside the pool.
+ *
+ * Tasks with a node go to the current worker only if it is on that node, otherwise to the next worker of the node.
+ * With a single node every task may run on any worker, so tasks are queued without a node.
+ */
+
+void ThreadPool::push(std::function<void()> task, int node)
+{
+    bool anyNode = node < 0 || (std::size_t) node >= nodeWorkers.size() || nodeWorkers[node].empty();
+    std::size_t queue;
+    if (currentPool == this && (anyNode || workers[currentWorker]->node == node))
+    {
+        queue = currentWorker;
+    }
+    else if (anyNode)
+    {
+        queue = nextQueue.fetch_add(1) % workers.size();
+    }
+    else
+    {
+        queue = nodeWorkers[node][nextQueue.fetch_add(1) % nodeWorkers[node].size()];
+    }
+    if (nodeWorkers.size() == 1)
+    {
+        anyNode = true;
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        ++pending; // counted before it is visible, so a thief never decrements below zero
+        ++(anyNode ? pendingAnyNode : pendingOnNode[node]);
+    }
+    {
+        std::lock_guard<std::mutex> lock(workers[queue]->mutex);
+        workers[queue]->tasks.push_back(QueuedTask{std::move(task), anyNode ? -1 : node});
+    }
+    if (anyNode)
+    {
+        wake.notify_one();
+    }
+    else
+    {
+        wake.notify_all(); // only workers of the task's node may take it
+    }
+}
+
+/**
+ * @brief Takes a task from the back of own queue or steals one from the front of another queue.
+ *
+ * Queues of workers on the same NUMA node are checked before the others. Only tasks without a node are taken
+ * from workers of other nodes.
+ *
+ * @param self Index of the queue to start with.
+ * @param task The taken task.
+ * @return True if a task was taken.
+ */
+
+bool ThreadPool::takeTask(std::size_t self, std::function<void()>& task)
+{
+    {
+        std::lock_guard<std::mutex> lock(workers[self]->mutex);
+        if (!workers[self]->tasks.empty())
+        {
+            taken(workers[self]->tasks.back().node);
+            task = std::move(workers[self]->tasks.back().run);
+            workers[self]->tasks.pop_back();
+            return true;
+        }
+    }
+    for (std::size_t offset = 1; offset < 2 * workers.size(); ++offset)
+    {
+        bool sameNodeRound = offset < workers.size();
+        Worker& victim = *workers[(self + offset) % workers.size()];
+        if (sameNodeRound != (victim.node == workers[self]->node) || &victim == workers[self].get())
+        {
+            continue;
+        }
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty() && (sameNodeRound || victim.tasks.front().node < 0))
+        {
+            taken(victim.tasks.front().node);
+            task = std::move(victim.tasks.front().run);
+            victim.tasks.pop_front();
+            if (currentPool == this)
+            {
+                ++workers[self]->stolen;
+            }
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Removes the taken task from the counters of pending tasks.
+ *
+ * @param node NUMA node of the task, negative for tasks without a node.
+ */
+
+void ThreadPool::taken(int node)
+{
+    --pending;
+    --(node < 0 ? pendingAnyNode : pendingOnNode[node]);
+}
+
+/**
+ * @brief Checks whether any queue may hold a task the worker is allowed to take.
+ *
+ * @param self Index of the worker.
+ */
+
+bool ThreadPool::hasTaskFor(std::size_t self) const
+{
+    return pendingAnyNode.load() > 0 || pendingOnNode[workers[self]->node].load() > 0;
+}
+
+/**
+ * @brief Runs the task and adds its time to the worker counters.
+ */
+
+void ThreadPool::runTask(std::size_t self, std::function<void()>& task)
+{
+    auto begin = std::chrono::steady_clock::now();
+    task();
+    auto busy = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - begin).count();
+    if (currentPool == this)
+    {
+        workers[self]->busyNanoseconds += busy;
+        ++workers[self]->executed;
+    }
+    else
+    {
+        ++executedOutside;
+    }
+}
+
+/**
+ * @brief Runs a single queued task on the calling thread, used while waiting for a future.
+ *
+ * Threads outside a pool spread over NUMA nodes do not run tasks, as they would first touch data of the tasks
+ * on their own node.
+ *
+ * @return True if a task was run.
+ */
+
+bool ThreadPool::runPendingTask()
+{
+    if (currentPool != this && nodeWorkers.size() > 1)
+    {
+        return false;
+    }
+    std::size_t self = currentPool == this ? currentWorker : nextQueue.load() % workers.size();
+    std::function<void()> task;
+    if (!takeTask(self, task))
+    {
+        return false;
+    }
+    runTask(self, task);
+    return true;
+}
+
+/**
+ * @brief Main loop of a worker, runs tasks until the pool is stopped and all queues are empty.
+ */
+
+void ThreadPool::workerLoop(std::size_t index)
+{
+    currentPool = this;
+    currentWorker = index;
+
+    while (true)
+    {
+        std::function<void()> task;
+        if (takeTask(index, task))
+        {
+            runTask(index, task);
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this, index]() { return stopping || hasTaskFor(index); });
+        if (stopping && !hasTaskFor(index))
+        {
+            return;
+        }
+    }
+}
+
+/**
+ * @brief Creates the shared pool, with NUMA awareness workers are placed on nodes by placeWorkersOnNodes.
+ *
+ * @return False if any worker could not be pinned to its CPU.
+ */
+
+bool configureSharedPool(std::size_t threadCount, const std::vector<int>& cpus, bool numaAware)
+{
+    std::lock_guard<std::mutex> lock(sharedInstanceMutex);
+    sharedInstance.reset();
+    if (numaAware)
+    {
+        std::vector<int> workerCpus;
+        std::vector<int> workerNodes;
+        placeWorkersOnNodes(threadCount, cpus, workerCpus, workerNodes);
+        sharedInstance = std::make_unique<ThreadPool>(workerCpus.size(), workerCpus, workerNodes);
+    }
+    else
+    {
+        sharedInstance = std::make_unique<ThreadPool>(threadCount, cpus);
+    }
+    return sharedInstance->pinningFailures().empty();
+}
+
+ThreadPool& sharedPool()
+{
+    std::lock_guard<std::mutex> lock(sharedInstanceMutex);
+    if (!sharedInstance)
+    {
+        sharedInstance = std::make_unique<ThreadPool>();
+    }
+    return *sharedInstance;
+}
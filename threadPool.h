@@ -0,0 +1,302 @@
+#ifndef DARWIN_THREAD_POOL_H
+#define DARWIN_THREAD_POOL_H
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @file threadPool.h
+ * @brief Declares the process-wide work-stealing thread pool used by the loader, the evolution process and the writer.
+ */
+
+/**
+ * @struct PoolStats
+ * @brief Utilization of the thread pool since it was created.
+ */
+struct PoolStats
+{
+    std::size_t threads;                ///< Number of worker threads.
+    std::size_t nodes;                  ///< Number of NUMA nodes the workers are placed on.
+    unsigned long long tasksExecuted;   ///< Number of tasks executed by workers and waiting threads.
+    unsigned long long tasksStolen;     ///< Number of tasks taken from the queue of another worker.
+    double utilization;                 ///< Busy time of workers divided by their lifetime, from 0 to 1.
+};
+
+/**
+ * @class ThreadPool
+ * @brief Work-stealing thread pool.
+ *
+ * Every worker owns a queue. Tasks submitted from a worker go to its own queue and are taken from the back,
+ * tasks submitted from other threads are spread over the queues. Idle workers steal from the front of other queues.
+ *
+ * Workers may be assigned to NUMA nodes. Tasks submitted with a node run only on the workers of that node, so data
+ * first touched by such a task is always allocated on its node. Idle workers steal from their own node first, and
+ * take tasks without a node from other nodes.
+ */
+class ThreadPool
+{
+public:
+    /**
+     * @brief Starts the workers.
+     *
+     * @param threadCount Number of workers, 0 means one per CPU (or one per CPU from the affinity list).
+     * @param cpus CPUs the workers are pinned to, worker i is pinned to cpus[i % cpus.size()]. Empty means no pinning.
+     * @param nodes NUMA nodes of the workers numbered from 0, worker i is on nodes[i % nodes.size()]. Empty means one node.
+     */
+    explicit ThreadPool(std::size_t threadCount = 0, const std::vector<int>& cpus = {}, const std::vector<int>& nodes = {});
+
+    /**
+     * @brief Finishes all queued tasks and joins the workers.
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * @brief Queues the task.
+     *
+     * @param task Callable without arguments.
+     * @param node NUMA node the task should run on, negative means any node.
+     * @return Future of the task result.
+     */
+    template<typename Task>
+    auto submit(Task task, int node = -1) -> std::future<decltype(task())>
+    {
+        using Result = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        std::future<Result> future = packaged->get_future();
+        push([packaged]() { (*packaged)(); }, node);
+        return future;
+    }
+
+    /**
+     * @brief Waits for the future, running queued tasks in the meantime instead of blocking.
+     *
+     * @param future Future returned by submit.
+     * @return The result of the task.
+     */
+    template<typename Result>
+    Result wait(std::future<Result>& future)
+    {
+        while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+        {
+            if (!runPendingTask())
+            {
+                future.wait_for(std::chrono::microseconds(100));
+            }
+        }
+        return future.get();
+    }
+
+    /**
+     * @brief Returns the number of workers.
+     */
+    std::size_t size() const;
+
+    /**
+     * @brief Returns the number of NUMA nodes the workers are placed on.
+     */
+    std::size_t nodeCount() const;
+
+    /**
+     * @brief Returns CPUs the workers could not be pinned to, empty if every worker was pinned.
+     */
+    const std::vector<int>& pinningFailures() const;
+
+    /**
+     * @brief Returns utilization of the pool.
+     */
+    PoolStats stats() const;
+
+private:
+    struct QueuedTask
+    {
+        std::function<void()> run;
+        int node;                       ///< NUMA node the task must run on, negative means any node.
+    };
+
+    struct Worker
+    {
+        std::mutex mutex;
+        std::deque<QueuedTask> tasks;
+        std::thread thread;
+        int node = 0;
+        std::atomic<unsigned long long> executed{0};
+        std::atomic<unsigned long long> stolen{0};
+        std::atomic<long long> busyNanoseconds{0};
+    };
+
+    void push(std::function<void()> task, int node);
+    bool runPendingTask();
+    bool takeTask(std::size_t self, std::function<void()>& task);
+    void taken(int node);
+    bool hasTaskFor(std::size_t self) const;
+    void runTask(std::size_t self, std::function<void()>& task);
+    void workerLoop(std::size_t index);
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::vector<std::size_t>> nodeWorkers;
+    std::atomic<std::size_t> pending{0};
+    std::atomic<std::size_t> pendingAnyNode{0};
+    std::unique_ptr<std::atomic<std::size_t>[]> pendingOnNode;
+    std::atomic<std::size_t> nextQueue{0};
+    std::atomic<unsigned long long> executedOutside{0};
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    bool stopping = false;
+    std::chrono::steady_clock::time_point started;
+    std::vector<int> unpinnedCpus;
+};
+
+/**
+ * @brief Returns the size of chunks submitChunks splits [0, count) into.
+ *
+ * @param pool The pool running the chunks.
+ * @param count Number of elements.
+ * @param minChunkSize The smallest chunk worth a separate task.
+ * @return Number of elements in every chunk except the last one.
+ */
+inline std::size_t chunkSizeFor(const ThreadPool& pool, std::size_t count, std::size_t minChunkSize)
+{
+    return std::max(minChunkSize, (count + pool.size() - 1) / pool.size());
+}
+
+/**
+ * @brief Returns the NUMA node submitChunks runs the element of [0, count) on.
+ *
+ * @param pool The pool running the chunks.
+ * @param index Index of the element.
+ * @param count Number of elements.
+ * @param minChunkSize The smallest chunk worth a separate task.
+ * @return Node of the chunk containing the element.
+ */
+inline int chunkNode(const ThreadPool& pool, std::size_t index, std::size_t count, std::size_t minChunkSize)
+{
+    std::size_t chunkSize = chunkSizeFor(pool, count, minChunkSize);
+    std::size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+    return (int) (index / chunkSize * pool.nodeCount() / chunkCount);
+}
+
+/**
+ * @brief Splits [0, count) into chunks and submits the task for every chunk.
+ *
+ * The range is split into contiguous partitions, one per NUMA node, and chunks of a partition run on its node.
+ *
+ * @param pool The pool running the chunks.
+ * @param count Number of elements.
+ * @param minChunkSize The smallest chunk worth a separate task.
+ * @param task Callable taking (begin, end) of a chunk.
+ * @return Futures of the chunks in their order.
+ */
+template<typename Task>
+auto submitChunks(ThreadPool& pool, std::size_t count, std::size_t minChunkSize, Task task)
+    -> std::vector<std::future<decltype(task(std::size_t(), std::size_t()))>>
+{
+    using Result = decltype(task(std::size_t(), std::size_t()));
+    std::size_t chunkSize = chunkSizeFor(pool, count, minChunkSize);
+    std::size_t chunkCount = (count + chunkSize - 1) / chunkSize;
+
+    std::vector<std::future<Result>> chunks;
+    for (std::size_t chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        std::size_t begin = chunk * chunkSize;
+        std::size_t end = std::min(begin + chunkSize, count);
+        int node = chunkNode(pool, begin, count, minChunkSize);
+        chunks.push_back(pool.submit([task, begin, end]() { return task(begin, end); }, node));
+    }
+    return chunks;
+}
+
+/**
+ * @brief Returns the size of chunks submitNodeChunks splits [0, count) into.
+ *
+ * @param pool The pool running the chunks.
+ * @param count Number of elements.
+ * @param minChunkSize The smallest chunk worth a separate task.
+ * @return Number of elements in every chunk except the last one.
+ */
+inline std::size_t nodeChunkSizeFor(const ThreadPool& pool, std::size_t count, std::size_t minChunkSize)
+{
+    std::size_t nodeWorkers = std::max<std::size_t>(1, pool.size() / pool.nodeCount());
+    return std::max(minChunkSize, (count + nodeWorkers - 1) / nodeWorkers);
+}
+
+/**
+ * @brief Splits [0, count) into chunks and submits the task for every chunk to the workers of a single NUMA node.
+ *
+ * Used for data that already lives on the node, for example a segment of the population.
+ *
+ * @param pool The pool running the chunks.
+ * @param node NUMA node running every chunk.
+ * @param count Number of elements.
+ * @param minChunkSize The smallest chunk worth a separate task.
+ * @param task Callable taking (begin, end) of a chunk.
+ * @return Futures of the chunks in their order.
+ */
+template<typename Task>
+auto submitNodeChunks(ThreadPool& pool, int node, std::size_t count, std::size_t minChunkSize, Task task)
+    -> std::vector<std::future<decltype(task(std::size_t(), std::size_t()))>>
+{
+    using Result = decltype(task(std::size_t(), std::size_t()));
+    std::size_t chunkSize = nodeChunkSizeFor(pool, count, minChunkSize);
+
+    std::vector<std::future<Result>> chunks;
+    for (std::size_t begin = 0; begin < count; begin += chunkSize)
+    {
+        std::size_t end = std::min(begin + chunkSize, count);
+        chunks.push_back(pool.submit([task, begin, end]() { return task(begin, end); }, node));
+    }
+    return chunks;
+}
+
+/**
+ * @brief Splits [0, count) into chunks and runs the task on every chunk in the pool.
+ *
+ * @param pool The pool running the chunks.
+ * @param count Number of elements.
+ * @param minChunkSize The smallest chunk worth a separate task.
+ * @param task Callable taking (begin, end) of a chunk.
+ * @return Results of the chunks in their order.
+ */
+template<typename Task>
+auto runInChunks(ThreadPool& pool, std::size_t count, std::size_t minChunkSize, Task task)
+    -> std::vector<decltype(task(std::size_t(), std::size_t()))>
+{
+    auto chunks = submitChunks(pool, count, minChunkSize, task);
+
+    std::vector<decltype(task(std::size_t(), std::size_t()))> results;
+    results.reserve(chunks.size());
+    for (auto& chunk : chunks)
+    {
+        results.push_back(pool.wait(chunk));
+    }
+    return results;
+}
+
+/**
+ * @brief Creates the shared pool with the given settings, must be called before the first use of sharedPool.
+ *
+ * @param threadCount Number of workers, 0 means one per CPU.
+ * @param cpus CPUs the workers are pinned to, empty means no pinning.
+ * @param numaAware Whether workers are spread over NUMA nodes and pinned to CPUs of their node.
+ * @return False if any worker could not be pinned, for example to a CPU that does not exist or is not allowed.
+ */
+bool configureSharedPool(std::size_t threadCount, const std::vector<int>& cpus, bool numaAware = false);
+
+/**
+ * @brief Returns the process-wide pool, created with default settings if it was not configured.
+ */
+ThreadPool& sharedPool();
+
+#endif // DARWIN_THREAD_POOL_H